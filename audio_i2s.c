@@ -31,6 +31,17 @@
 
 #include "misc.h"
 #include "audio_i2s.h"
+#include "axi_dma_mm2s.h"
+
+// FIFO reporting in the audio pipeline (see audio_pipeline.vhd)
+#define AUDIO_I2S_PACKET_LEN        0x10        // words per AXIS packet (TLAST), 0 = the pipeline default of 256
+#define AUDIO_I2S_DROPPED           0x14        // number of samples dropped because the FIFO was full
+#define AUDIO_I2S_MAX_PACKET_LEN    4095        // the DMA length register is 14 bits (bytes) by default
+#define AUDIO_I2S_CR_FIFO_RST       (1 << 1)
+#define AUDIO_I2S_SR_LEVEL_MASK     0xffff
+#define AUDIO_I2S_SR_EMPTY          (1 << 16)
+#define AUDIO_I2S_SR_FULL           (1 << 17)
+#define AUDIO_I2S_SR_OVERFLOW       (1 << 18)   // sticky until the FIFO is reset
 
 
 /**
@@ -82,8 +93,67 @@ uint32_t audio_i2s_get_key(audio_i2s_t *config) {
     return _reg_get(config->v_baseaddr, AUDIO_I2S_KEY);
 }
 
-int32_t* audio_i2s_recv(audio_i2s_t *config){  //, void *buffer) { // Currently set to size 256
-    axi_dma_s2mm_transfer(&config->s2mm, TRANSFER_LEN*sizeof(uint32_t));
-    // memcpy(buffer, (void*) config->s2mm->v_dst_addr, TRANSFER_LEN*sizeof(uint32_t));
+uint32_t audio_i2s_fifo_level(audio_i2s_t *config) {
+    return _reg_get(config->v_baseaddr, AUDIO_I2S_SR) & AUDIO_I2S_SR_LEVEL_MASK;
+}
+
+uint8_t audio_i2s_fifo_overflowed(audio_i2s_t *config) {
+    return (_reg_get(config->v_baseaddr, AUDIO_I2S_SR) & AUDIO_I2S_SR_OVERFLOW) ? 1 : 0;
+}
+
+uint32_t audio_i2s_fifo_dropped(audio_i2s_t *config) {
+    return _reg_get(config->v_baseaddr, AUDIO_I2S_DROPPED);
+}
+
+/**
+ * @brief Empty the FIFO and clear its overflow flag and dropped counter, and the playback underrun flag.
+ * 
+ * @param config 
+ */
+void audio_i2s_fifo_reset(audio_i2s_t *config) {
+    uint32_t cr = _reg_get(config->v_baseaddr, AUDIO_I2S_CR);
+    _reg_set(config->v_baseaddr, AUDIO_I2S_CR, cr | AUDIO_I2S_CR_FIFO_RST);
+    _reg_set(config->v_baseaddr, AUDIO_I2S_CR, cr & ~AUDIO_I2S_CR_FIFO_RST);
+}
+
+/**
+ * @brief Set how many words the pipeline puts in each AXIS packet. Takes effect from the next packet.
+ * Large packets mean fewer DMA re-arms per second, small ones mean less latency.
+ * 
+ * @param config 
+ * @param len words per packet, clamped to AUDIO_I2S_MAX_PACKET_LEN
+ * @return uint32_t the packet length that was set
+ */
+uint32_t audio_i2s_set_packet_len(audio_i2s_t *config, uint32_t len) {
+    if (len == 0 || len > AUDIO_I2S_MAX_PACKET_LEN) {
+        len = AUDIO_I2S_MAX_PACKET_LEN;
+    }
+    _reg_set(config->v_baseaddr, AUDIO_I2S_PACKET_LEN, len);
+    return len;
+}
+
+/**
+ * @brief Receive one packet of len words, which should match the packet length set with audio_i2s_set_packet_len.
+ * 
+ * @param config 
+ * @param len words to transfer
+ * @return int32_t* the DMA buffer holding the words
+ */
+int32_t* audio_i2s_recv(audio_i2s_t *config, uint32_t len) {
+    if (len > AUDIO_I2S_MAX_PACKET_LEN) {
+        len = AUDIO_I2S_MAX_PACKET_LEN;
+    }
+    axi_dma_s2mm_transfer(&config->s2mm, len*sizeof(uint32_t));
     return (int32_t*) config->s2mm.v_dst_addr;
 }
+
+/**
+ * @brief Number of words the last audio_i2s_recv actually received. Only the first this many
+ * words of the buffer are new, the packet may have ended before len words.
+ * 
+ * @param config 
+ * @return uint32_t words received
+ */
+uint32_t audio_i2s_received(audio_i2s_t *config) {
+    return dma_s2mm_length(&config->s2mm) / sizeof(uint32_t);
+}
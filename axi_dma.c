@@ -24,72 +24,189 @@
  */
 
 #include "axi_dma.h"
+#include "axi_dma_mm2s.h"
 
 #include <stdio.h> // todo: remove this once debugging is finished
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/mman.h>
 
+#define AXI_DMA_DST_MAP_SIZE 0xffff
+#define AXI_DMA_SR_ERRORS ((1 << AXI_DMA_SR_DMA_INT_ERR) | (1 << AXI_DMA_SR_DMA_SLV_ERR) | (1 << AXI_DMA_SR_DMA_DEC_ERR))
+#define AXI_DMA_SR_IRQS ((1 << AXI_DMA_SR_IOC_IRQ) | (1 << AXI_DMA_SR_DLY_IRQ) | (1 << AXI_DMA_SR_ERR_IRQ))
+
+// Register access, built with -DAXI_DMA_SIM it goes to the simulated core instead of the hardware
+#ifdef AXI_DMA_SIM
+#include "axi_dma_sim.h"
+#define dma_reg_get(device, reg) axi_dma_sim_read((device)->v_baseaddr, reg)
+#define dma_reg_set(device, reg, value) axi_dma_sim_write((device)->v_baseaddr, reg, value)
+#else
+#define dma_reg_get(device, reg) _reg_get((device)->v_baseaddr, reg)
+#define dma_reg_set(device, reg, value) _reg_set((device)->v_baseaddr, reg, value)
+#endif
+
 /*
  * AXI DMA general function
  */
-int32_t axi_dma_init(axi_dma_t *device, uint32_t baseaddr, uint32_t dst_addr, uint32_t size) {
+void *axi_dma_map(uint32_t paddr, uint32_t size) {
+#ifdef AXI_DMA_SIM
+    return axi_dma_sim_map(paddr, size);
+#else
     // Open /dev/mem for memory mapping
     int32_t dev_fd = open("/dev/mem", O_RDWR | O_SYNC);
     if (dev_fd < 0) {
-        return -1;
+        return NULL;
     }
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, dev_fd, paddr);
+    close(dev_fd);
+    return addr == MAP_FAILED ? NULL : addr;
+#endif
+}
 
+void axi_dma_unmap(void *addr, uint32_t size) {
+#ifdef AXI_DMA_SIM
+    (void)size;
+    axi_dma_sim_unmap(addr);
+#else
+    munmap(addr, size);
+#endif
+}
+
+static void release_regs(axi_dma_t *device) {
+#ifdef AXI_DMA_SIM
+    axi_dma_sim_close(device->v_baseaddr);
+#else
+    munmap(device->v_baseaddr, device->size);
+#endif
+}
+
+int32_t axi_dma_init(axi_dma_t *device, uint32_t baseaddr, uint32_t dst_addr, uint32_t size) {
     // Init device
     device->size = size;
     device->p_baseaddr = baseaddr;
-    device->v_baseaddr = (uint32_t *) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, dev_fd, baseaddr);
-    if (device->v_baseaddr == MAP_FAILED) {
-        close(dev_fd);
+#ifdef AXI_DMA_SIM
+    device->v_baseaddr = axi_dma_sim_open(baseaddr);
+#else
+    device->v_baseaddr = (uint32_t *) axi_dma_map(baseaddr, size);
+#endif
+    if (device->v_baseaddr == NULL) {
         return -1;
     }
 
     if (dma_s2mm_sg_active(device)) {
-        close(dev_fd);
+        release_regs(device);
         return -1;
     }
+    // resets both channels, nothing is playing yet
     dma_s2mm_reset(device);
 
     // Init buffers
     device->p_dst_addr = dst_addr;
-    device->v_dst_addr = (void *) mmap(NULL, 0xffff, PROT_READ | PROT_WRITE, MAP_SHARED, dev_fd, dst_addr);
-    if (device->v_dst_addr == MAP_FAILED) {
-        munmap(device->v_baseaddr, device->size);
-        close(dev_fd);
+    device->v_dst_addr = axi_dma_map(dst_addr, AXI_DMA_DST_MAP_SIZE);
+    if (device->v_dst_addr == NULL) {
+        release_regs(device);
         return -1;
     }
 
-    close(dev_fd);
     return 0;
 }
 
 void axi_dma_release(axi_dma_t *device) {
-    munmap(device->v_baseaddr, device->size);
-    munmap(device->v_dst_addr, device->size);
+    release_regs(device);
+    axi_dma_unmap(device->v_dst_addr, AXI_DMA_DST_MAP_SIZE);
 }
 
-void axi_dma_s2mm_transfer(axi_dma_t *device, uint32_t size) {
-    // Clearup
-    dma_s2mm_reset(device);
-    dma_s2mm_stop(device);
+void axi_dma_s2mm_start(axi_dma_t *device, uint32_t size) {
+    // Clearup. A reset would also cut off playback, so it is only used to recover from an error.
+    if (dma_s2mm_error(device)) {
+        dma_s2mm_reset(device);
+    }
+    dma_s2mm_ack_irq(device);
 
     // Config and start
     dma_s2mm_set_dst_addr(device, device->p_dst_addr);
-    _reg_set(device->v_baseaddr, AXI_DMA_S2MM_CR, 0xf001);
-    _reg_set(device->v_baseaddr, AXI_DMA_S2MM_LENGTH, size);
-    
+    dma_reg_set(device, AXI_DMA_S2MM_CR, 0xf001);
+    dma_reg_set(device, AXI_DMA_S2MM_LENGTH, size);
+}
+
+void axi_dma_s2mm_transfer(axi_dma_t *device, uint32_t size) {
+    axi_dma_s2mm_start(device, size);
     dma_s2mm_busy_wait(device);
 }
 
 void dma_s2mm_busy_wait(axi_dma_t *device) {
-    volatile uint32_t s2mm_sr = _reg_get(device->v_baseaddr, AXI_DMA_S2MM_SR);
+    volatile uint32_t s2mm_sr = dma_reg_get(device, AXI_DMA_S2MM_SR);
     while (!(s2mm_sr & (1 << AXI_DMA_SR_IDLE))) {
-        s2mm_sr = _reg_get(device->v_baseaddr, AXI_DMA_S2MM_SR);
+        s2mm_sr = dma_reg_get(device, AXI_DMA_S2MM_SR);
+    }
+}
+
+void axi_dma_mm2s_start(axi_dma_t *device, uint32_t src_addr, uint32_t size) {
+    // A halted channel only comes back through a reset, which also restarts capture
+    if (dma_mm2s_error(device)) {
+        dma_mm2s_reset(device);
+    }
+    dma_mm2s_ack_irq(device);
+
+    // Config and start, the write to the length register starts the transfer
+    dma_reg_set(device, AXI_DMA_MM2S_CR, (1 << AXI_DMA_CR_RS) | (1 << AXI_DMA_CR_IOC_IRQ_EN) | (1 << AXI_DMA_CR_ERR_IRQ_EN));
+    dma_mm2s_set_src_addr(device, src_addr);
+    dma_mm2s_set_length(device, size);
+}
+
+void axi_dma_mm2s_transfer(axi_dma_t *device, uint32_t src_addr, uint32_t size) {
+    axi_dma_mm2s_start(device, src_addr, size);
+    dma_mm2s_busy_wait(device);
+}
+
+void dma_mm2s_busy_wait(axi_dma_t *device) {
+    volatile uint32_t mm2s_sr = dma_reg_get(device, AXI_DMA_MM2S_SR);
+    while (!(mm2s_sr & (1 << AXI_DMA_SR_IDLE))) {
+        mm2s_sr = dma_reg_get(device, AXI_DMA_MM2S_SR);
+    }
+}
+
+/*
+ * DMA interrupts
+ */
+
+void dma_mm2s_ack_irq(axi_dma_t *device) {
+    dma_reg_set(device, AXI_DMA_MM2S_SR, AXI_DMA_SR_IRQS);
+}
+
+void dma_s2mm_ack_irq(axi_dma_t *device) {
+    dma_reg_set(device, AXI_DMA_S2MM_SR, AXI_DMA_SR_IRQS);
+}
+
+int axi_dma_irq_open(const char *path) {
+    int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    // UIO masks the line after each interrupt, writing 1 unmasks it
+    uint32_t enable = 1;
+    if (write(fd, &enable, sizeof(enable)) != sizeof(enable)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+uint32_t axi_dma_irq_ack(int fd) {
+    uint32_t count = 0;
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+        return 0;
+    }
+    uint32_t enable = 1;
+    if (write(fd, &enable, sizeof(enable)) != sizeof(enable)) {
+        perror("DMA interrupt");
+    }
+    return count;
+}
+
+void axi_dma_irq_close(int fd) {
+    if (fd >= 0) {
+        close(fd);
     }
 }
 
@@ -97,9 +214,8 @@ void dma_s2mm_busy_wait(axi_dma_t *device) {
  * DMA status
  */
 
-void dma_s2mm_status(axi_dma_t *device) {
-    uint32_t status = _reg_get(device->v_baseaddr, AXI_DMA_S2MM_SR);
-    printf("Stream to Memory-mapped status (0x%08x@0x%02x):", status, AXI_DMA_S2MM_SR);
+static void print_status(const char *name, uint32_t status, uint32_t reg) {
+    printf("%s status (0x%08x@0x%02x):", name, status, reg);
     if (status & (1 << AXI_DMA_SR_HALTED))
         printf(" halted");
     else
@@ -129,6 +245,14 @@ void dma_s2mm_status(axi_dma_t *device) {
     printf("\n");
 }
 
+void dma_s2mm_status(axi_dma_t *device) {
+    print_status("Stream to Memory-mapped", dma_reg_get(device, AXI_DMA_S2MM_SR), AXI_DMA_S2MM_SR);
+}
+
+void dma_mm2s_status(axi_dma_t *device) {
+    print_status("Memory-mapped to Stream", dma_reg_get(device, AXI_DMA_MM2S_SR), AXI_DMA_MM2S_SR);
+}
+
 void axi_dma_read_data(void *address, int byte_length) {
     int *addr = (int *) address;
     int reg_offset;
@@ -144,7 +268,16 @@ void axi_dma_read_data(void *address, int byte_length) {
 }
 
 uint32_t dma_s2mm_sr(axi_dma_t *device) {
-    return _reg_get(device->v_baseaddr, AXI_DMA_S2MM_SR);
+    return dma_reg_get(device, AXI_DMA_S2MM_SR);
+}
+
+uint32_t dma_s2mm_length(axi_dma_t *device) {
+    // in direct register mode the length register reads back what the finished transfer wrote
+    return dma_reg_get(device, AXI_DMA_S2MM_LENGTH);
+}
+
+uint32_t dma_mm2s_sr(axi_dma_t *device) {
+    return dma_reg_get(device, AXI_DMA_MM2S_SR);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -152,47 +285,47 @@ uint32_t dma_s2mm_sr(axi_dma_t *device) {
 ////////////////////////////////////////////////////////////////////////////////
 
 void dma_s2mm_reset(axi_dma_t *device) {
-    _reg_set(device->v_baseaddr, AXI_DMA_S2MM_CR, 1 << AXI_DMA_CR_RESET);
+    dma_reg_set(device, AXI_DMA_S2MM_CR, 1 << AXI_DMA_CR_RESET);
 }
 
 void dma_s2mm_run(axi_dma_t *device) {
-    uint32_t cr = _reg_get(device->v_baseaddr, AXI_DMA_S2MM_CR);
-    _reg_set(device->v_baseaddr, AXI_DMA_S2MM_CR, cr | (1 << AXI_DMA_CR_RS));
+    uint32_t cr = dma_reg_get(device, AXI_DMA_S2MM_CR);
+    dma_reg_set(device, AXI_DMA_S2MM_CR, cr | (1 << AXI_DMA_CR_RS));
 }
 
 void dma_s2mm_stop(axi_dma_t *device) {
-    uint32_t cr = _reg_get(device->v_baseaddr, AXI_DMA_S2MM_CR);
-    _reg_set(device->v_baseaddr, AXI_DMA_S2MM_CR, cr & ~(1 << AXI_DMA_CR_RS));
+    uint32_t cr = dma_reg_get(device, AXI_DMA_S2MM_CR);
+    dma_reg_set(device, AXI_DMA_S2MM_CR, cr & ~(1 << AXI_DMA_CR_RS));
 }
 
 void dma_s2mm_IOC_IRQ_EN(axi_dma_t *device) {
-    uint32_t cr = _reg_get(device->v_baseaddr, AXI_DMA_S2MM_CR);
-    _reg_set(device->v_baseaddr, AXI_DMA_S2MM_CR, cr | (1 << AXI_DMA_CR_IOC_IRQ_EN));
+    uint32_t cr = dma_reg_get(device, AXI_DMA_S2MM_CR);
+    dma_reg_set(device, AXI_DMA_S2MM_CR, cr | (1 << AXI_DMA_CR_IOC_IRQ_EN));
 }
 
 void dma_s2mm_IOC_IRQ_DIS(axi_dma_t *device) {
-    uint32_t cr = _reg_get(device->v_baseaddr, AXI_DMA_S2MM_CR);
-    _reg_set(device->v_baseaddr, AXI_DMA_S2MM_CR, cr & ~(1 << AXI_DMA_CR_IOC_IRQ_EN));
+    uint32_t cr = dma_reg_get(device, AXI_DMA_S2MM_CR);
+    dma_reg_set(device, AXI_DMA_S2MM_CR, cr & ~(1 << AXI_DMA_CR_IOC_IRQ_EN));
 }
 
 void dma_s2mm_DLY_IRO_EN(axi_dma_t *device) {
-    uint32_t cr = _reg_get(device->v_baseaddr, AXI_DMA_S2MM_CR);
-    _reg_set(device->v_baseaddr, AXI_DMA_S2MM_CR, cr | (1 << AXI_DMA_CR_DLY_IRQ_EN));
+    uint32_t cr = dma_reg_get(device, AXI_DMA_S2MM_CR);
+    dma_reg_set(device, AXI_DMA_S2MM_CR, cr | (1 << AXI_DMA_CR_DLY_IRQ_EN));
 }
 
 void dma_s2mm_DLY_IRO_DIS(axi_dma_t *device) {
-    uint32_t cr = _reg_get(device->v_baseaddr, AXI_DMA_S2MM_CR);
-    _reg_set(device->v_baseaddr, AXI_DMA_S2MM_CR, cr & ~(1 << AXI_DMA_CR_DLY_IRQ_EN));
+    uint32_t cr = dma_reg_get(device, AXI_DMA_S2MM_CR);
+    dma_reg_set(device, AXI_DMA_S2MM_CR, cr & ~(1 << AXI_DMA_CR_DLY_IRQ_EN));
 }
 
 void dma_s2mm_ERR_IRQ_EN(axi_dma_t *device) {
-    uint32_t cr = _reg_get(device->v_baseaddr, AXI_DMA_S2MM_CR);
-    _reg_set(device->v_baseaddr, AXI_DMA_S2MM_CR, cr | (1 << AXI_DMA_CR_ERR_IRQ_EN));
+    uint32_t cr = dma_reg_get(device, AXI_DMA_S2MM_CR);
+    dma_reg_set(device, AXI_DMA_S2MM_CR, cr | (1 << AXI_DMA_CR_ERR_IRQ_EN));
 }
 
 void dma_s2mm_ERR_IRQ_DIS(axi_dma_t *device) {
-    uint32_t cr = _reg_get(device->v_baseaddr, AXI_DMA_S2MM_CR);
-    _reg_set(device->v_baseaddr, AXI_DMA_S2MM_CR, cr & ~(1 << AXI_DMA_CR_ERR_IRQ_EN));
+    uint32_t cr = dma_reg_get(device, AXI_DMA_S2MM_CR);
+    dma_reg_set(device, AXI_DMA_S2MM_CR, cr & ~(1 << AXI_DMA_CR_ERR_IRQ_EN));
 }
 
 
@@ -200,17 +333,66 @@ void dma_s2mm_ERR_IRQ_DIS(axi_dma_t *device) {
 // Writing to this register will start the transfer
 
 void dma_s2mm_set_dst_addr(axi_dma_t *device, uint32_t addr) {
-    _reg_set(device->v_baseaddr, AXI_DMA_S2MM_DST_ADDR, addr);
+    dma_reg_set(device, AXI_DMA_S2MM_DST_ADDR, addr);
 }
 
 void dma_s2mm_set_dst_addr_msb(axi_dma_t *device, uint32_t addr) {
-    _reg_set(device->v_baseaddr, AXI_DMA_S2MM_DST_ADDR_MSB, addr);
+    dma_reg_set(device, AXI_DMA_S2MM_DST_ADDR_MSB, addr);
 }
 
 // Sets the number of bytes (length) for the s2mm transfer
 // Writing to this register will start the transfer
 void dma_s2mm_set_length(axi_dma_t *device, uint32_t length) {
-    _reg_set(device->v_baseaddr, AXI_DMA_S2MM_LENGTH, length);
+    dma_reg_set(device, AXI_DMA_S2MM_LENGTH, length);
+}
+
+
+void dma_mm2s_reset(axi_dma_t *device) {
+    dma_reg_set(device, AXI_DMA_MM2S_CR, 1 << AXI_DMA_CR_RESET);
+}
+
+void dma_mm2s_run(axi_dma_t *device) {
+    uint32_t cr = dma_reg_get(device, AXI_DMA_MM2S_CR);
+    dma_reg_set(device, AXI_DMA_MM2S_CR, cr | (1 << AXI_DMA_CR_RS));
+}
+
+void dma_mm2s_stop(axi_dma_t *device) {
+    uint32_t cr = dma_reg_get(device, AXI_DMA_MM2S_CR);
+    dma_reg_set(device, AXI_DMA_MM2S_CR, cr & ~(1 << AXI_DMA_CR_RS));
+}
+
+void dma_mm2s_IOC_IRQ_EN(axi_dma_t *device) {
+    uint32_t cr = dma_reg_get(device, AXI_DMA_MM2S_CR);
+    dma_reg_set(device, AXI_DMA_MM2S_CR, cr | (1 << AXI_DMA_CR_IOC_IRQ_EN));
+}
+
+void dma_mm2s_IOC_IRQ_DIS(axi_dma_t *device) {
+    uint32_t cr = dma_reg_get(device, AXI_DMA_MM2S_CR);
+    dma_reg_set(device, AXI_DMA_MM2S_CR, cr & ~(1 << AXI_DMA_CR_IOC_IRQ_EN));
+}
+
+void dma_mm2s_ERR_IRQ_EN(axi_dma_t *device) {
+    uint32_t cr = dma_reg_get(device, AXI_DMA_MM2S_CR);
+    dma_reg_set(device, AXI_DMA_MM2S_CR, cr | (1 << AXI_DMA_CR_ERR_IRQ_EN));
+}
+
+void dma_mm2s_ERR_IRQ_DIS(axi_dma_t *device) {
+    uint32_t cr = dma_reg_get(device, AXI_DMA_MM2S_CR);
+    dma_reg_set(device, AXI_DMA_MM2S_CR, cr & ~(1 << AXI_DMA_CR_ERR_IRQ_EN));
+}
+
+void dma_mm2s_set_src_addr(axi_dma_t *device, uint32_t addr) {
+    dma_reg_set(device, AXI_DMA_MM2S_SRC_ADDR, addr);
+}
+
+void dma_mm2s_set_src_addr_msb(axi_dma_t *device, uint32_t addr) {
+    dma_reg_set(device, AXI_DMA_MM2S_SRC_ADDR_MSB, addr);
+}
+
+// Sets the number of bytes (length) for the mm2s transfer
+// Writing to this register will start the transfer
+void dma_mm2s_set_length(axi_dma_t *device, uint32_t length) {
+    dma_reg_set(device, AXI_DMA_MM2S_LENGTH, length);
 }
 
 
@@ -219,42 +401,71 @@ void dma_s2mm_set_length(axi_dma_t *device, uint32_t length) {
 ////////////////////////////////////////////////////////////////////////////////
 
 uint8_t dma_s2mm_halted(axi_dma_t *device) {
-    return (_reg_get(device->v_baseaddr, AXI_DMA_S2MM_SR) & (1 << AXI_DMA_SR_HALTED)) ? 1 : 0;
+    return (dma_reg_get(device, AXI_DMA_S2MM_SR) & (1 << AXI_DMA_SR_HALTED)) ? 1 : 0;
 }
 
 uint8_t dma_s2mm_idle(axi_dma_t *device) {
-    return (_reg_get(device->v_baseaddr, AXI_DMA_S2MM_SR) & (1 << AXI_DMA_SR_IDLE)) ? 1 : 0;
+    return (dma_reg_get(device, AXI_DMA_S2MM_SR) & (1 << AXI_DMA_SR_IDLE)) ? 1 : 0;
 }
 
 uint8_t dma_s2mm_busy(axi_dma_t *device) {
-    uint32_t sr = _reg_get(device->v_baseaddr, AXI_DMA_S2MM_SR);
+    uint32_t sr = dma_reg_get(device, AXI_DMA_S2MM_SR);
     return (!(sr & (1 << AXI_DMA_SR_IOC_IRQ)) && !(sr & (1 << AXI_DMA_SR_IDLE))) ? 1 : 0;
 }
 
 uint8_t dma_s2mm_sg_active(axi_dma_t *device) {
-    return (_reg_get(device->v_baseaddr, AXI_DMA_S2MM_SR) & (1 << AXI_DMA_SR_SG_ACT)) ? 1 : 0;
+    return (dma_reg_get(device, AXI_DMA_S2MM_SR) & (1 << AXI_DMA_SR_SG_ACT)) ? 1 : 0;
 }
 
 uint8_t dma_s2mm_dma_internal_error(axi_dma_t *device) {
-    return (_reg_get(device->v_baseaddr, AXI_DMA_S2MM_SR) & (1 << AXI_DMA_SR_DMA_INT_ERR)) ? 1 : 0;
+    return (dma_reg_get(device, AXI_DMA_S2MM_SR) & (1 << AXI_DMA_SR_DMA_INT_ERR)) ? 1 : 0;
 }
 
 uint8_t dma_s2mm_dma_slave_error(axi_dma_t *device) {
-    return (_reg_get(device->v_baseaddr, AXI_DMA_S2MM_SR) & (1 << AXI_DMA_SR_DMA_SLV_ERR)) ? 1 : 0;
+    return (dma_reg_get(device, AXI_DMA_S2MM_SR) & (1 << AXI_DMA_SR_DMA_SLV_ERR)) ? 1 : 0;
 }
 
 uint8_t dma_s2mm_dma_decode_error(axi_dma_t *device) {
-    return (_reg_get(device->v_baseaddr, AXI_DMA_S2MM_SR) & (1 << AXI_DMA_SR_DMA_DEC_ERR)) ? 1 : 0;
+    return (dma_reg_get(device, AXI_DMA_S2MM_SR) & (1 << AXI_DMA_SR_DMA_DEC_ERR)) ? 1 : 0;
 }
 
 uint8_t dma_s2mm_IOC_IRQ(axi_dma_t *device) {
-    return (_reg_get(device->v_baseaddr, AXI_DMA_S2MM_SR) & (1 << AXI_DMA_SR_IOC_IRQ)) ? 1 : 0;
+    return (dma_reg_get(device, AXI_DMA_S2MM_SR) & (1 << AXI_DMA_SR_IOC_IRQ)) ? 1 : 0;
 }
 
 uint8_t dma_s2mm_DLY_IRQ(axi_dma_t *device) {
-    return (_reg_get(device->v_baseaddr, AXI_DMA_S2MM_SR) & (1 << AXI_DMA_SR_DLY_IRQ)) ? 1 : 0;
+    return (dma_reg_get(device, AXI_DMA_S2MM_SR) & (1 << AXI_DMA_SR_DLY_IRQ)) ? 1 : 0;
 }
 
 uint8_t dma_s2mm_ERR_IRQ(axi_dma_t *device) {
-    return (_reg_get(device->v_baseaddr, AXI_DMA_S2MM_SR) & (1 << AXI_DMA_SR_ERR_IRQ)) ? 1 : 0;
+    return (dma_reg_get(device, AXI_DMA_S2MM_SR) & (1 << AXI_DMA_SR_ERR_IRQ)) ? 1 : 0;
+}
+
+uint8_t dma_s2mm_error(axi_dma_t *device) {
+    return (dma_reg_get(device, AXI_DMA_S2MM_SR) & AXI_DMA_SR_ERRORS) ? 1 : 0;
+}
+
+uint8_t dma_mm2s_halted(axi_dma_t *device) {
+    return (dma_reg_get(device, AXI_DMA_MM2S_SR) & (1 << AXI_DMA_SR_HALTED)) ? 1 : 0;
+}
+
+uint8_t dma_mm2s_idle(axi_dma_t *device) {
+    return (dma_reg_get(device, AXI_DMA_MM2S_SR) & (1 << AXI_DMA_SR_IDLE)) ? 1 : 0;
+}
+
+uint8_t dma_mm2s_busy(axi_dma_t *device) {
+    uint32_t sr = dma_reg_get(device, AXI_DMA_MM2S_SR);
+    return (!(sr & (1 << AXI_DMA_SR_IOC_IRQ)) && !(sr & (1 << AXI_DMA_SR_IDLE))) ? 1 : 0;
+}
+
+uint8_t dma_mm2s_error(axi_dma_t *device) {
+    return (dma_reg_get(device, AXI_DMA_MM2S_SR) & AXI_DMA_SR_ERRORS) ? 1 : 0;
+}
+
+uint8_t dma_mm2s_IOC_IRQ(axi_dma_t *device) {
+    return (dma_reg_get(device, AXI_DMA_MM2S_SR) & (1 << AXI_DMA_SR_IOC_IRQ)) ? 1 : 0;
+}
+
+uint8_t dma_mm2s_ERR_IRQ(axi_dma_t *device) {
+    return (dma_reg_get(device, AXI_DMA_MM2S_SR) & (1 << AXI_DMA_SR_ERR_IRQ)) ? 1 : 0;
 }
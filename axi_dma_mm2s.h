@@ -0,0 +1,85 @@
+/** COMP3601 Design Project A
+ * File name: axi_dma_mm2s.h
+ * Description: The memory-mapped to stream (playback) half of the AXI DMA driver, implemented in
+ * 	axi_dma.c next to the S2MM functions declared in axi_dma.h. Both channels share one register
+ * 	block and one axi_dma_t.
+ * 	A soft reset on either channel resets the whole core, so once both directions are in use
+ * 	neither side resets the core unless its channel has halted on an error.
+ */
+
+#ifndef AXI_DMA_MM2S_H
+#define AXI_DMA_MM2S_H
+
+#include <stdint.h>
+
+#include "axi_dma.h"
+
+// MM2S channel registers
+#define AXI_DMA_MM2S_CR 0x00
+#define AXI_DMA_MM2S_SR 0x04
+#define AXI_DMA_MM2S_SRC_ADDR 0x18
+#define AXI_DMA_MM2S_SRC_ADDR_MSB 0x1c
+#define AXI_DMA_MM2S_LENGTH 0x28
+
+#define AXI_DMA_MAX_LENGTH 0x3fff       // bytes per transfer, the core is built with 14 bit length registers
+
+/*
+ * Buffers, physical memory mapped through /dev/mem (or the simulated backend)
+ */
+void *axi_dma_map(uint32_t paddr, uint32_t size);
+void axi_dma_unmap(void *addr, uint32_t size);
+
+/*
+ * Transfers
+ */
+// Start sending size bytes from physical address src_addr and return straight away
+void axi_dma_mm2s_start(axi_dma_t *device, uint32_t src_addr, uint32_t size);
+// Send size bytes from src_addr and wait until the channel is idle again
+void axi_dma_mm2s_transfer(axi_dma_t *device, uint32_t src_addr, uint32_t size);
+void dma_mm2s_busy_wait(axi_dma_t *device);
+// Start receiving size bytes into the device's buffer and return straight away, for callers that
+// service playback while a capture block comes in. Done once dma_s2mm_idle.
+void axi_dma_s2mm_start(axi_dma_t *device, uint32_t size);
+
+/*
+ * Interrupts. The IOC/error flags are cleared by writing them back to the status register.
+ * With a UIO device for the DMA interrupt line the caller can sleep in poll() instead of
+ * polling the flags.
+ */
+void dma_mm2s_ack_irq(axi_dma_t *device);
+void dma_s2mm_ack_irq(axi_dma_t *device);
+// Open the UIO device (e.g. "/dev/uio0") and enable its interrupt, -1 on error
+int axi_dma_irq_open(const char *path);
+// After poll() reports the fd readable: read the interrupt count and re-enable. Returns the count.
+uint32_t axi_dma_irq_ack(int fd);
+void axi_dma_irq_close(int fd);
+
+/*
+ * Status, setters and getters
+ */
+void dma_mm2s_status(axi_dma_t *device);
+uint32_t dma_mm2s_sr(axi_dma_t *device);
+// Bytes the last S2MM transfer actually wrote once it is idle, less than asked for when the
+// packet's TLAST came early
+uint32_t dma_s2mm_length(axi_dma_t *device);
+
+void dma_mm2s_reset(axi_dma_t *device);
+void dma_mm2s_run(axi_dma_t *device);
+void dma_mm2s_stop(axi_dma_t *device);
+void dma_mm2s_IOC_IRQ_EN(axi_dma_t *device);
+void dma_mm2s_IOC_IRQ_DIS(axi_dma_t *device);
+void dma_mm2s_ERR_IRQ_EN(axi_dma_t *device);
+void dma_mm2s_ERR_IRQ_DIS(axi_dma_t *device);
+void dma_mm2s_set_src_addr(axi_dma_t *device, uint32_t addr);
+void dma_mm2s_set_src_addr_msb(axi_dma_t *device, uint32_t addr);
+void dma_mm2s_set_length(axi_dma_t *device, uint32_t length);
+
+uint8_t dma_mm2s_halted(axi_dma_t *device);
+uint8_t dma_mm2s_idle(axi_dma_t *device);
+uint8_t dma_mm2s_busy(axi_dma_t *device);
+uint8_t dma_mm2s_error(axi_dma_t *device);
+uint8_t dma_s2mm_error(axi_dma_t *device);
+uint8_t dma_mm2s_IOC_IRQ(axi_dma_t *device);
+uint8_t dma_mm2s_ERR_IRQ(axi_dma_t *device);
+
+#endif
@@ -0,0 +1,216 @@
+/** COMP3601 Design Project A
+ * File name: axi_dma_sim.c
+ * Description: Simulated AXI DMA register block (see axi_dma_sim.h).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "axi_dma.h"
+#include "axi_dma_sim.h"
+
+// Channel registers, relative to the channel (MM2S at 0x00, S2MM at 0x30)
+#define SIM_S2MM_BASE 0x30
+#define SIM_CR 0x00
+#define SIM_SR 0x04
+#define SIM_ADDR 0x18
+#define SIM_LENGTH 0x28
+#define SIM_REGS 0x60
+
+#define SIM_SR_W1C ((1 << AXI_DMA_SR_IOC_IRQ) | (1 << AXI_DMA_SR_DLY_IRQ) | (1 << AXI_DMA_SR_ERR_IRQ))
+
+typedef struct {
+    axi_dma_sim_fn_t fn;
+    void *arg;
+    bool in_flight;
+} sim_channel_t;
+
+typedef struct {
+    uint32_t regs[SIM_REGS / 4];        // first, the driver only sees this
+    uint32_t baseaddr;
+    sim_channel_t channels[2];          // MM2S, S2MM
+    bool auto_complete;
+    uint32_t resets;
+} sim_dma_t;
+
+typedef struct {
+    uint32_t paddr;
+    uint32_t size;
+    void *addr;
+} sim_region_t;
+
+static sim_region_t regions[AXI_DMA_SIM_REGIONS];
+
+static sim_dma_t *sim_of(uint32_t *regs) {
+    return (sim_dma_t *)regs;
+}
+
+static uint32_t *reg(sim_dma_t *sim, int channel, uint32_t offset) {
+    return &sim->regs[((channel == 0 ? 0 : SIM_S2MM_BASE) + offset) / 4];
+}
+
+static void reset_core(sim_dma_t *sim) {
+    // a soft reset on either channel resets both, anything in flight is lost
+    memset(sim->regs, 0, sizeof(sim->regs));
+    for (int c = 0; c < 2; c++) {
+        *reg(sim, c, SIM_SR) = 1 << AXI_DMA_SR_HALTED;
+        sim->channels[c].in_flight = false;
+    }
+    sim->resets++;
+}
+
+uint32_t *axi_dma_sim_open(uint32_t baseaddr) {
+    sim_dma_t *sim = (sim_dma_t *)calloc(1, sizeof(sim_dma_t));
+    if (sim == NULL) {
+        fprintf(stderr, "Unable to allocate enough memory\n");
+        return NULL;
+    }
+    sim->baseaddr = baseaddr;
+    reset_core(sim);
+    sim->resets = 0;
+    return sim->regs;
+}
+
+void axi_dma_sim_close(uint32_t *regs) {
+    free(sim_of(regs));
+}
+
+void *axi_dma_sim_map(uint32_t paddr, uint32_t size) {
+    for (int r = 0; r < AXI_DMA_SIM_REGIONS; r++) {
+        if (regions[r].addr == NULL) {
+            regions[r].addr = calloc(1, size);
+            if (regions[r].addr == NULL) {
+                fprintf(stderr, "Unable to allocate enough memory\n");
+                return NULL;
+            }
+            regions[r].paddr = paddr;
+            regions[r].size = size;
+            return regions[r].addr;
+        }
+    }
+    fprintf(stderr, "Too many simulated DMA buffers\n");
+    return NULL;
+}
+
+void axi_dma_sim_unmap(void *addr) {
+    for (int r = 0; r < AXI_DMA_SIM_REGIONS; r++) {
+        if (regions[r].addr == addr && addr != NULL) {
+            free(addr);
+            regions[r].addr = NULL;
+        }
+    }
+}
+
+static void *translate(uint32_t paddr, uint32_t len) {
+    for (int r = 0; r < AXI_DMA_SIM_REGIONS; r++) {
+        sim_region_t *region = &regions[r];
+        if (region->addr != NULL && paddr >= region->paddr && (uint64_t)paddr + len <= (uint64_t)region->paddr + region->size) {
+            return (uint8_t *)region->addr + (paddr - region->paddr);
+        }
+    }
+    return NULL;
+}
+
+static bool complete(sim_dma_t *sim, int channel) {
+    sim_channel_t *ch = &sim->channels[channel];
+    if (!ch->in_flight) {
+        return false;
+    }
+    ch->in_flight = false;
+
+    uint32_t *sr = reg(sim, channel, SIM_SR);
+    uint32_t len = *reg(sim, channel, SIM_LENGTH);
+    void *data = translate(*reg(sim, channel, SIM_ADDR), len);
+    if (data == NULL) {
+        // nothing at that address, the core halts with a decode error
+        *sr |= (1 << AXI_DMA_SR_HALTED) | (1 << AXI_DMA_SR_IDLE) | (1 << AXI_DMA_SR_DMA_DEC_ERR) | (1 << AXI_DMA_SR_ERR_IRQ);
+        return true;
+    }
+    if (ch->fn != NULL) {
+        ch->fn(ch->arg, data, len);
+    }
+    *sr |= (1 << AXI_DMA_SR_IDLE) | (1 << AXI_DMA_SR_IOC_IRQ);
+    return true;
+}
+
+uint32_t axi_dma_sim_read(uint32_t *regs, uint32_t offset) {
+    sim_dma_t *sim = sim_of(regs);
+    if (offset >= SIM_REGS) {
+        return 0;
+    }
+    int channel = offset >= SIM_S2MM_BASE ? 1 : 0;
+    if (sim->auto_complete && offset == (channel == 0 ? 0 : SIM_S2MM_BASE) + SIM_SR) {
+        complete(sim, channel);
+    }
+    return regs[offset / 4];
+}
+
+void axi_dma_sim_write(uint32_t *regs, uint32_t offset, uint32_t value) {
+    sim_dma_t *sim = sim_of(regs);
+    if (offset >= SIM_REGS) {
+        return;
+    }
+    int channel = offset >= SIM_S2MM_BASE ? 1 : 0;
+    uint32_t local = offset - (channel == 0 ? 0 : SIM_S2MM_BASE);
+    uint32_t *sr = reg(sim, channel, SIM_SR);
+
+    switch (local) {
+    case SIM_CR:
+        if (value & (1 << AXI_DMA_CR_RESET)) {
+            reset_core(sim);
+            return;
+        }
+        regs[offset / 4] = value;
+        if (value & (1 << AXI_DMA_CR_RS)) {
+            if (*sr & (1 << AXI_DMA_SR_HALTED)) {
+                *sr = (*sr & ~(1 << AXI_DMA_SR_HALTED)) | (1 << AXI_DMA_SR_IDLE);
+            }
+        } else {
+            // stopping drops the transfer in flight
+            sim->channels[channel].in_flight = false;
+            *sr |= 1 << AXI_DMA_SR_HALTED;
+        }
+        break;
+    case SIM_SR:
+        *sr &= ~(value & SIM_SR_W1C);
+        break;
+    case SIM_LENGTH:
+        regs[offset / 4] = value;
+        if ((*sr & (1 << AXI_DMA_SR_HALTED)) == 0 && value != 0) {
+            *sr &= ~(1 << AXI_DMA_SR_IDLE);
+            sim->channels[channel].in_flight = true;
+        }
+        break;
+    default:
+        regs[offset / 4] = value;
+        break;
+    }
+}
+
+void axi_dma_sim_set_mm2s_sink(uint32_t *regs, axi_dma_sim_fn_t fn, void *arg) {
+    sim_of(regs)->channels[0].fn = fn;
+    sim_of(regs)->channels[0].arg = arg;
+}
+
+void axi_dma_sim_set_s2mm_source(uint32_t *regs, axi_dma_sim_fn_t fn, void *arg) {
+    sim_of(regs)->channels[1].fn = fn;
+    sim_of(regs)->channels[1].arg = arg;
+}
+
+void axi_dma_sim_set_auto(uint32_t *regs, bool on) {
+    sim_of(regs)->auto_complete = on;
+}
+
+int axi_dma_sim_step(uint32_t *regs) {
+    sim_dma_t *sim = sim_of(regs);
+    int completed = 0;
+    for (int c = 0; c < 2; c++) {
+        completed += complete(sim, c) ? 1 : 0;
+    }
+    return completed;
+}
+
+uint32_t axi_dma_sim_resets(uint32_t *regs) {
+    return sim_of(regs)->resets;
+}
@@ -0,0 +1,49 @@
+/** COMP3601 Design Project A
+ * File name: axi_dma_sim.h
+ * Description: Simulated AXI DMA register block for testing the driver without the board.
+ * 	Build axi_dma.c with -DAXI_DMA_SIM and every register access goes through here instead of
+ * 	/dev/mem. The model follows the direct register mode of the real core: writing a channel's
+ * 	length starts a transfer, the status register reports idle/IOC, IOC is cleared by writing 1
+ * 	and a soft reset on either channel resets the whole core.
+ *
+ * 	Time only passes when the test says so: a transfer stays in flight until axi_dma_sim_step,
+ * 	unless auto completion is on, in which case it finishes on the first status read (enough for
+ * 	the blocking transfer functions).
+ */
+
+#ifndef AXI_DMA_SIM_H
+#define AXI_DMA_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define AXI_DMA_SIM_REGIONS 8           // buffers that can be mapped at the same time
+
+// Called when a transfer completes with the buffer the DMA read (MM2S) or is filling (S2MM)
+typedef void (*axi_dma_sim_fn_t)(void *arg, void *data, uint32_t len);
+
+// Register block for the core at baseaddr, NULL if out of memory
+uint32_t *axi_dma_sim_open(uint32_t baseaddr);
+void axi_dma_sim_close(uint32_t *regs);
+
+// Stand-ins for mmap of /dev/mem: zeroed memory the model can find from its physical address
+void *axi_dma_sim_map(uint32_t paddr, uint32_t size);
+void axi_dma_sim_unmap(void *addr);
+
+uint32_t axi_dma_sim_read(uint32_t *regs, uint32_t reg);
+void axi_dma_sim_write(uint32_t *regs, uint32_t reg, uint32_t value);
+
+// Where played samples go and where captured samples come from. Either may be NULL.
+void axi_dma_sim_set_mm2s_sink(uint32_t *regs, axi_dma_sim_fn_t fn, void *arg);
+void axi_dma_sim_set_s2mm_source(uint32_t *regs, axi_dma_sim_fn_t fn, void *arg);
+
+// Complete transfers on the first status read instead of waiting for axi_dma_sim_step
+void axi_dma_sim_set_auto(uint32_t *regs, bool on);
+
+// Complete whatever is in flight on both channels. Returns the number of transfers completed.
+int axi_dma_sim_step(uint32_t *regs);
+
+// Number of soft resets, a reset during playback cuts off the transfer in flight
+uint32_t axi_dma_sim_resets(uint32_t *regs);
+
+#endif
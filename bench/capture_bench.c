@@ -0,0 +1,122 @@
+/** COMP3601 Design Project A
+ * File name: capture_bench.c
+ * Description: Cost of the capture conversion pass per DMA block, taken the way getSound takes it.
+ * 	Each take is armed with the same timeout, hears ARMED_SECONDS of quiet noise and then a tone,
+ * 	which the onset detector picks up and records until the take is full. The input is encoded the
+ * 	way the I2S receiver delivers it (bit reversed, microphone on one word of each L/R pair).
+ * 	Blocks that start armed go through the detector and the pre-roll, the rest only convert, so the
+ * 	two are timed separately. Everything runs once on its own and once feeding the input meter.
+ * 	The figure to compare against is the block period, the time one block takes to arrive.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "capture.h"
+
+#define SAMPLE_RATE 41000
+#define BLOCK_WORDS 1024                // one DMA block, 512 samples
+#define TAKE_SAMPLES (SAMPLE_RATE / 2)  // getSound's BUF_SIZE
+#define ARM_TIMEOUT (SAMPLE_RATE * 3)   // getSound's ARM_TIMEOUT
+#define ARMED_SECONDS 2                 // of noise before the tone in each take
+#define TAKES 40
+#define NOISE_BLOCKS 8                  // different blocks of noise cycled through
+
+static uint32_t noise[NOISE_BLOCKS][BLOCK_WORDS];
+static uint32_t tone[BLOCK_WORDS];
+static int32_t out[TAKE_SAMPLES];
+
+typedef struct {
+    uint32_t blocks;
+    uint64_t total_ns;
+    uint64_t max_ns;
+} timing_t;
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint32_t reverse_bits(uint32_t x) {
+    uint32_t r = 0;
+    for (int i = 0; i < 32; i++) {
+        r |= ((x >> i) & 1) << (31 - i);
+    }
+    return r;
+}
+
+static uint32_t encode(double v) {
+    // never 0, which would read as a dropped word
+    return reverse_bits((uint32_t)(int32_t)(v * 2147483647.0) | 1);
+}
+
+static void timed_block(capture_t *cap, const uint32_t *words, timing_t *armed, timing_t *recording) {
+    timing_t *timing = cap->triggered ? recording : armed;
+    uint64_t start = now_ns();
+    capture_block(cap, words, BLOCK_WORDS);
+    uint64_t elapsed = now_ns() - start;
+    timing->blocks++;
+    timing->total_ns += elapsed;
+    if (elapsed > timing->max_ns) {
+        timing->max_ns = elapsed;
+    }
+}
+
+static void print_timing(const char *name, const timing_t *timing) {
+    double period_us = 1e6 * (BLOCK_WORDS / 2) / SAMPLE_RATE;
+    double avg_us = timing->total_ns / 1000.0 / timing->blocks;
+    printf("  %s: %u blocks, avg %.2fus max %.2fus per block (%.3f%% of the %.0fus block period)\n",
+           name, timing->blocks, avg_us, timing->max_ns / 1000.0, 100.0 * avg_us / period_us, period_us);
+}
+
+int main(void) {
+    srand(1);
+    for (int b = 0; b < NOISE_BLOCKS; b++) {
+        for (int i = 0; i < BLOCK_WORDS / 2; i++) {
+            noise[b][2 * i] = encode(0.001 * (rand() / (double)RAND_MAX - 0.5));
+            noise[b][2 * i + 1] = 0;
+        }
+    }
+    for (int i = 0; i < BLOCK_WORDS / 2; i++) {
+        tone[2 * i] = encode(0.3 * sin(2.0 * M_PI * 440.0 * i / SAMPLE_RATE));
+        tone[2 * i + 1] = 0;
+    }
+
+    int armed_blocks = ARMED_SECONDS * SAMPLE_RATE / (BLOCK_WORDS / 2);
+    for (int metered = 0; metered < 2; metered++) {
+        meter_t meter;
+        if (meter_init(&meter, SAMPLE_RATE) < 0) {
+            return 1;
+        }
+        timing_t armed = {0, 0, 0};
+        timing_t recording = {0, 0, 0};
+        uint32_t onsets = 0;
+
+        for (int take = 0; take < TAKES; take++) {
+            capture_t cap;
+            capture_init(&cap, out, TAKE_SAMPLES, ARM_TIMEOUT);
+            if (metered) {
+                capture_set_meter(&cap, &meter);
+            }
+            for (int b = 0; b < armed_blocks; b++) {
+                timed_block(&cap, noise[b % NOISE_BLOCKS], &armed, &recording);
+            }
+            while (!capture_done(&cap)) {
+                timed_block(&cap, tone, &armed, &recording);
+            }
+            onsets += cap.seen < ARM_TIMEOUT ? 1 : 0;
+        }
+
+        printf("%s, %u of %d takes started on the onset:\n", metered ? "with meter" : "without meter", onsets, TAKES);
+        print_timing("armed", &armed);
+        print_timing("recording", &recording);
+        if (metered) {
+            meter_print_stats(&meter, SAMPLE_RATE);
+        }
+        meter_destroy(&meter);
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+/** COMP3601 Design Project A
+ * File name: codec_bench.c
+ * Description: Size and speed of the slot codec on a half second take: a decaying tone with a
+ * 	little noise, rounded to the microphone's 18 bits as capture_finish leaves it. Timings are
+ * 	the best of several runs, against the half second it took to record.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "capture.h"
+#include "slot_codec.h"
+
+#define SAMPLE_RATE 41000
+#define NUM_SAMPLES (SAMPLE_RATE / 2)
+#define RUNS 50
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+int main(void) {
+    int32_t *samples = (int32_t *)malloc(NUM_SAMPLES * sizeof(int32_t));
+    int32_t *decoded = (int32_t *)malloc(NUM_SAMPLES * sizeof(int32_t));
+    uint8_t *encoded = (uint8_t *)malloc(slot_codec_max_size(NUM_SAMPLES));
+    if (samples == NULL || decoded == NULL || encoded == NULL) {
+        fprintf(stderr, "Unable to allocate enough memory\n");
+        return 1;
+    }
+
+    srand(1);
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+        double v = 0.3 * sin(i * 0.07) * exp(-i / 8000.0) + 0.001 * ((rand() % 2001) - 1000) / 1000.0;
+        samples[i] = capture_quantize((int32_t)(v * 2147483647.0));
+    }
+
+    size_t size = 0;
+    uint64_t best_enc = UINT64_MAX;
+    uint64_t best_dec = UINT64_MAX;
+    for (int r = 0; r < RUNS; r++) {
+        uint64_t start = now_ns();
+        size = slot_codec_encode(samples, NUM_SAMPLES, SAMPLE_RATE, encoded);
+        uint64_t mid = now_ns();
+        int ret = slot_codec_decode(encoded, size, decoded);
+        uint64_t end = now_ns();
+        if (ret != 0 || memcmp(samples, decoded, NUM_SAMPLES * sizeof(int32_t)) != 0) {
+            fprintf(stderr, "Decoded take does not match\n");
+            return 1;
+        }
+        best_enc = mid - start < best_enc ? mid - start : best_enc;
+        best_dec = end - mid < best_dec ? end - mid : best_dec;
+    }
+
+    printf("slot codec: %d samples, %zu bytes (%.2fx), encode %.3fms decode %.3fms\n", NUM_SAMPLES, size,
+           (double)NUM_SAMPLES * sizeof(int32_t) / size, best_enc / 1e6, best_dec / 1e6);
+    free(samples);
+    free(decoded);
+    free(encoded);
+    return 0;
+}
@@ -0,0 +1,157 @@
+/** COMP3601 Design Project A
+ * File name: fft_bench.c
+ * Description: The radix-4 FFT (fft.c) against the plain radix-2 FFT it replaced, at the meter's
+ * 	transform size and a time-stretch correlation size. Both are checked to agree first.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "fft.h"
+
+#define WORK 20000000                   // butterflies' worth of transforms per timing, roughly
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// The radix-2 FFT: bit reversal then log2(n) passes of butterflies with a strided twiddle table
+typedef struct {
+    int n;
+    int *bitrev;
+    float *cos_tw;
+    float *sin_tw;
+} radix2_t;
+
+static radix2_t *radix2_create(int n) {
+    radix2_t *plan = (radix2_t *)malloc(sizeof(radix2_t));
+    if (plan == NULL) {
+        return NULL;
+    }
+    plan->n = n;
+    plan->bitrev = (int *)malloc(n * sizeof(int));
+    plan->cos_tw = (float *)malloc(n / 2 * sizeof(float));
+    plan->sin_tw = (float *)malloc(n / 2 * sizeof(float));
+    if (plan->bitrev == NULL || plan->cos_tw == NULL || plan->sin_tw == NULL) {
+        return NULL;
+    }
+
+    int bits = 0;
+    while ((1 << bits) < n) {
+        bits++;
+    }
+    for (int i = 0; i < n; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++) {
+            if (i & (1 << b)) {
+                r |= 1 << (bits - 1 - b);
+            }
+        }
+        plan->bitrev[i] = r;
+    }
+    for (int k = 0; k < n / 2; k++) {
+        plan->cos_tw[k] = (float)cos(2.0 * M_PI * k / n);
+        plan->sin_tw[k] = (float)sin(2.0 * M_PI * k / n);
+    }
+    return plan;
+}
+
+static void radix2_destroy(radix2_t *plan) {
+    free(plan->bitrev);
+    free(plan->cos_tw);
+    free(plan->sin_tw);
+    free(plan);
+}
+
+static void radix2_execute(const radix2_t *plan, float *re, float *im, bool inverse) {
+    int n = plan->n;
+    for (int i = 0; i < n; i++) {
+        int j = plan->bitrev[i];
+        if (j > i) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+
+    float sign = inverse ? 1.0f : -1.0f;
+    for (int len = 2; len <= n; len <<= 1) {
+        int half = len / 2;
+        int stride = n / len;
+        for (int start = 0; start < n; start += len) {
+            for (int k = 0; k < half; k++) {
+                float wr = plan->cos_tw[k * stride];
+                float wi = sign * plan->sin_tw[k * stride];
+                int a = start + k;
+                int b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+static int bench(int n) {
+    fft_plan_t *plan = fft_plan_create(n);
+    radix2_t *ref = radix2_create(n);
+    float *re = (float *)malloc(n * sizeof(float));
+    float *im = (float *)malloc(n * sizeof(float));
+    float *ref_re = (float *)malloc(n * sizeof(float));
+    float *ref_im = (float *)malloc(n * sizeof(float));
+    if (plan == NULL || ref == NULL || re == NULL || im == NULL || ref_re == NULL || ref_im == NULL) {
+        fprintf(stderr, "Unable to allocate enough memory\n");
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        re[i] = ref_re[i] = rand() / (float)RAND_MAX - 0.5f;
+        im[i] = ref_im[i] = rand() / (float)RAND_MAX - 0.5f;
+    }
+    fft_execute(plan, re, im, false);
+    radix2_execute(ref, ref_re, ref_im, false);
+    for (int i = 0; i < n; i++) {
+        if (fabsf(re[i] - ref_re[i]) > 1e-3f * sqrtf((float)n) || fabsf(im[i] - ref_im[i]) > 1e-3f * sqrtf((float)n)) {
+            fprintf(stderr, "n=%d: transforms differ at bin %d\n", n, i);
+            return -1;
+        }
+    }
+
+    // alternate directions so the data stays bounded
+    int iterations = WORK / n;
+    uint64_t start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        fft_execute(plan, re, im, i & 1);
+    }
+    uint64_t mid = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        radix2_execute(ref, ref_re, ref_im, i & 1);
+    }
+    uint64_t end = now_ns();
+
+    double fast_us = (mid - start) / 1000.0 / iterations;
+    double ref_us = (end - mid) / 1000.0 / iterations;
+    printf("fft n=%d: %.2fus, radix-2 %.2fus (%.2fx)\n", n, fast_us, ref_us, ref_us / fast_us);
+
+    fft_plan_destroy(plan);
+    radix2_destroy(ref);
+    free(re);
+    free(im);
+    free(ref_re);
+    free(ref_im);
+    return 0;
+}
+
+int main(void) {
+    if (bench(256) < 0 || bench(2048) < 0) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,222 @@
+/** COMP3601 Design Project A
+ * File name: capture.c
+ * Description: Capture conversion pass. Every DMA block is converted as soon as it arrives and each
+ * 	sample goes through the DSP chain (DC blocker, noise gate, pre-emphasis) and the onset detector
+ * 	in the same loop, so there is no second pass over the recording.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "capture.h"
+
+static inline uint32_t reverse_bits(uint32_t x) {
+    // The microphone word arrives LSB first, swap progressively larger groups of bits to reverse it
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    return __builtin_bswap32(x);
+}
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void capture_init(capture_t *cap, int32_t *out, uint32_t out_len, uint32_t arm_timeout) {
+    memset(cap, 0, sizeof(capture_t));
+    cap->out = out;
+    cap->out_len = out_len;
+    cap->channel = -1;
+    cap->arm_timeout = arm_timeout;
+    cap->dsp_flags = CAPTURE_DSP_DEFAULT;
+}
+
+static inline int32_t saturate(int64_t x) {
+    if (x > INT32_MAX) return INT32_MAX;
+    if (x < INT32_MIN) return INT32_MIN;
+    return (int32_t)x;
+}
+
+static inline int32_t dsp(capture_t *cap, int32_t x) {
+    // The whole chain for one sample, in fixed point so it stays cheap inside the conversion loop.
+    // Each stage is recursive, so samples are processed in order rather than in SIMD lanes.
+    uint32_t flags = cap->dsp_flags;
+    int64_t y = x;
+
+    if (flags & CAPTURE_DSP_DC_BLOCK) {
+        // y[n] = x[n] - x[n-1] + R * y[n-1]
+        y = (int64_t)x - cap->dc_x1 + ((cap->dc_y1 * CAPTURE_DC_POLE) >> 15);
+        cap->dc_x1 = x;
+        cap->dc_y1 = y;
+    }
+
+    if (flags & CAPTURE_DSP_NOISE_GATE) {
+        int32_t level = saturate(y < 0 ? -y : y);
+        int32_t env = cap->gate_env;
+        env = level > env ? level : env - (env >> CAPTURE_GATE_RELEASE_SHIFT);
+        cap->gate_env = env;
+
+        if (env > CAPTURE_GATE_OPEN) {
+            cap->gate_open = true;
+        } else if (env < CAPTURE_GATE_CLOSE) {
+            cap->gate_open = false;
+        }
+
+        // ramp the gain rather than switching it, so opening and closing do not click
+        int32_t gain = cap->gate_gain;
+        if (cap->gate_open) {
+            gain = gain + CAPTURE_GATE_RAMP > 32768 ? 32768 : gain + CAPTURE_GATE_RAMP;
+        } else {
+            gain = gain - CAPTURE_GATE_RAMP < 0 ? 0 : gain - CAPTURE_GATE_RAMP;
+        }
+        cap->gate_gain = gain;
+        y = (y * gain) >> 15;
+    }
+
+    if (flags & CAPTURE_DSP_PRE_EMPHASIS) {
+        // y[n] = x[n] - a * x[n-1]
+        int32_t in = saturate(y);
+        y = (int64_t)in - (((int64_t)cap->emph_x1 * CAPTURE_PRE_EMPHASIS) >> 15);
+        cap->emph_x1 = in;
+    }
+
+    return saturate(y);
+}
+
+static void trigger(capture_t *cap) {
+    // Start the take with the pre-roll, oldest sample first
+    cap->triggered = true;
+    uint32_t have = cap->seen < CAPTURE_PRE_ROLL ? cap->seen : CAPTURE_PRE_ROLL;
+    uint32_t start = (cap->pre_roll_pos + CAPTURE_PRE_ROLL - have) % CAPTURE_PRE_ROLL;
+    for (uint32_t i = 0; i < have && cap->written < cap->out_len; i++) {
+        cap->out[cap->written++] = cap->pre_roll[(start + i) % CAPTURE_PRE_ROLL];
+    }
+}
+
+static inline bool onset(capture_t *cap, int32_t sample) {
+    // Feed one sample to the detector, true when this sample completes a window that is an onset
+    float x = sample * (1.0f / 2147483648.0f);
+    cap->window_energy += x * x;
+    if (++cap->window_fill < CAPTURE_ONSET_WINDOW) {
+        return false;
+    }
+
+    float mean = cap->window_energy / CAPTURE_ONSET_WINDOW;
+    cap->window_energy = 0.0f;
+    cap->window_fill = 0;
+
+    if (cap->settle < CAPTURE_NOISE_SETTLE) {
+        cap->noise_floor += (mean - cap->noise_floor) / (cap->settle + 1);
+        cap->settle++;
+        return false;
+    }
+    if (mean > CAPTURE_ONSET_RATIO * cap->noise_floor && mean > CAPTURE_ONSET_MIN_LEVEL) {
+        return true;
+    }
+    cap->noise_floor += 0.05f * (mean - cap->noise_floor);
+    return false;
+}
+
+bool capture_block(capture_t *cap, const uint32_t *words, int count) {
+    uint64_t start = now_ns();
+
+    // check if the odd words are the channel without data or not
+    if (cap->channel < 0) {
+        cap->channel = words[0] == 0 ? 1 : 0;
+    }
+
+    int t = cap->channel;
+    int32_t last = cap->last;
+    meter_t *meter = cap->meter;
+
+    // Armed: keep a short history and wait for the onset
+    for (; t < count && !cap->triggered; t += 2) {
+        int32_t s = (int32_t)reverse_bits(words[t]);
+        if (s == 0) {
+            s = last;   // a dropped word, hold the previous sample
+        }
+        last = s;
+        s = dsp(cap, s);
+        if (meter != NULL) {
+            meter_sample(meter, s);
+        }
+
+        cap->pre_roll[cap->pre_roll_pos] = s;
+        cap->pre_roll_pos = (cap->pre_roll_pos + 1) % CAPTURE_PRE_ROLL;
+        cap->seen++;
+
+        if (onset(cap, s) || cap->seen >= cap->arm_timeout) {
+            trigger(cap);
+        }
+    }
+
+    // Recording: straight conversion into the output
+    int32_t *out = cap->out;
+    uint32_t written = cap->written;
+    for (; t < count && written < cap->out_len; t += 2) {
+        int32_t s = (int32_t)reverse_bits(words[t]);
+        if (s == 0) {
+            s = last;
+        }
+        last = s;
+        s = dsp(cap, s);
+        if (meter != NULL) {
+            meter_sample(meter, s);
+        }
+        out[written++] = s;
+    }
+    cap->written = written;
+    cap->last = last;
+    if (meter != NULL) {
+        meter_block(meter);
+    }
+
+    uint64_t elapsed = now_ns() - start;
+    cap->blocks++;
+    cap->total_ns += elapsed;
+    if (elapsed > cap->max_ns) {
+        cap->max_ns = elapsed;
+    }
+    cap->samples += count / 2;
+
+    return capture_done(cap);
+}
+
+void capture_finish(capture_t *cap) {
+    int32_t *out = cap->out;
+    uint32_t len = cap->written;
+
+    // Nothing arrived for the tail, leave it silent
+    if (len < cap->out_len) {
+        memset(out + len, 0, (cap->out_len - len) * sizeof(int32_t));
+    }
+
+    uint32_t fade_in = len < CAPTURE_FADE_IN ? len : CAPTURE_FADE_IN;
+    for (uint32_t i = 0; i < fade_in; i++) {
+        out[i] = (int32_t)((int64_t)out[i] * i / fade_in);
+    }
+
+    uint32_t fade_out = len < CAPTURE_FADE_OUT ? len : CAPTURE_FADE_OUT;
+    for (uint32_t i = 0; i < fade_out; i++) {
+        uint32_t p = len - fade_out + i;
+        out[p] = (int32_t)((int64_t)out[p] * (fade_out - 1 - i) / fade_out);
+    }
+
+    for (uint32_t i = 0; i < len; i++) {
+        out[i] = capture_quantize(out[i]);
+    }
+}
+
+void capture_print_stats(const capture_t *cap, uint32_t sample_rate) {
+    if (cap->blocks == 0) {
+        return;
+    }
+    double avg_us = cap->total_ns / 1000.0 / cap->blocks;
+    double budget_us = 1e6 * cap->samples / cap->blocks / sample_rate;
+    printf("capture: %s after %u samples, %u blocks, avg %.2fus max %.2fus per block (%.2f%% of the %.0fus block period)\n",
+           cap->triggered && cap->seen < cap->arm_timeout ? "onset" : "timeout", cap->seen, cap->blocks,
+           avg_us, cap->max_ns / 1000.0, 100.0 * avg_us / budget_us, budget_us);
+}
@@ -0,0 +1,119 @@
+/** COMP3601 Design Project A
+ * File name: capture.h
+ * Description: Capture conversion pass. Turns the raw DMA words into samples one block at a time,
+ * 	and runs an onset detector on the way so a take starts when the sound does. An optional level
+ * 	meter sees every sample after the DSP chain.
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "meter.h"
+
+#define CAPTURE_ONSET_WINDOW 64         // samples per energy measurement (~1.5ms at 41kHz)
+#define CAPTURE_ONSET_RATIO 4.0f        // window energy must be this many times the noise floor (~6dB in amplitude)
+#define CAPTURE_ONSET_MIN_LEVEL 1e-5f   // ...and above this absolute energy (full scale = 1)
+#define CAPTURE_NOISE_SETTLE 16         // windows used to learn the noise floor before arming
+#define CAPTURE_PRE_ROLL 128            // samples kept from before the onset so the attack is not clipped
+#define CAPTURE_FADE_IN 64              // fade lengths in samples
+#define CAPTURE_FADE_OUT 512
+#define CAPTURE_PCM_BITS 18             // the microphone's PCM_PRECISION, finished takes are rounded back to it
+
+// DSP stages run on each sample as it is converted, enabled per stage with these flags
+#define CAPTURE_DSP_DC_BLOCK        (1 << 0)    // one pole high-pass, removes the microphone's DC offset
+#define CAPTURE_DSP_NOISE_GATE      (1 << 1)    // mutes the hiss between sounds
+#define CAPTURE_DSP_PRE_EMPHASIS    (1 << 2)    // first order high shelf, brightens the dull MEMS response
+#define CAPTURE_DSP_DEFAULT         (CAPTURE_DSP_DC_BLOCK | CAPTURE_DSP_NOISE_GATE)
+
+// Coefficients are Q15 fixed point
+#define CAPTURE_DC_POLE 32604                   // 0.995, corner at ~33Hz for 41kHz
+#define CAPTURE_PRE_EMPHASIS 29491              // 0.9
+#define CAPTURE_GATE_OPEN (1 << 21)             // envelope level that opens the gate, ~-60dBFS
+#define CAPTURE_GATE_CLOSE (1 << 20)            // ...and closes it again, the gap stops it chattering
+#define CAPTURE_GATE_RELEASE_SHIFT 11           // envelope decays by 1/2048 per sample, ~50ms
+#define CAPTURE_GATE_RAMP 128                   // gain change per sample, a full open/close takes ~6ms
+
+typedef struct {
+    int32_t *out;           // destination, out_len samples
+    uint32_t out_len;
+    uint32_t written;
+
+    int channel;            // which word of each L/R pair carries the microphone, -1 until the first block
+    int32_t last;           // previous sample, repeated over dropped (zero) words
+
+    // DSP chain state
+    uint32_t dsp_flags;     // CAPTURE_DSP_*
+    int32_t dc_x1;          // previous input and output of the DC blocker
+    int64_t dc_y1;
+    int32_t emph_x1;        // previous input of the pre-emphasis
+    int32_t gate_env;       // peak envelope of the signal reaching the gate
+    int32_t gate_gain;      // current gate gain, Q15
+    bool gate_open;
+
+    // onset detector
+    bool triggered;
+    uint32_t arm_timeout;   // samples to wait for an onset before recording anyway
+    uint32_t seen;          // samples looked at while armed
+    float noise_floor;      // running mean energy per window while armed
+    float window_energy;
+    int window_fill;
+    int settle;
+    int32_t pre_roll[CAPTURE_PRE_ROLL];
+    uint32_t pre_roll_pos;
+
+    meter_t *meter;         // NULL for no metering, owned by the caller
+
+    // cost of the pass, for checking it fits in the capture budget
+    uint32_t blocks;
+    uint64_t samples;
+    uint64_t total_ns;
+    uint64_t max_ns;
+} capture_t;
+
+// Prepare to capture out_len samples into out. Recording is armed until an onset is found,
+// or until arm_timeout samples have gone by, in which case it starts regardless.
+void capture_init(capture_t *cap, int32_t *out, uint32_t out_len, uint32_t arm_timeout);
+
+// Choose the DSP stages (CAPTURE_DSP_* flags) applied from now on. capture_init selects CAPTURE_DSP_DEFAULT.
+static inline void capture_set_dsp(capture_t *cap, uint32_t flags) {
+    cap->dsp_flags = flags;
+}
+
+// Meter every sample from now on, armed or recording, NULL to stop. Updates are worked out at the
+// end of the block that completes a meter period, and are counted in the cost of that block.
+static inline void capture_set_meter(capture_t *cap, meter_t *meter) {
+    cap->meter = meter;
+}
+
+// Convert one DMA block of interleaved, bit reversed L/R words. Returns true once out is full.
+bool capture_block(capture_t *cap, const uint32_t *words, int count);
+
+static inline bool capture_done(const capture_t *cap) {
+    return cap->written >= cap->out_len;
+}
+
+// Start filling out from the beginning again, for converting a stream one block at a time into a
+// buffer of one block. The DSP chain carries on from where it was.
+static inline void capture_rewind(capture_t *cap) {
+    cap->written = 0;
+}
+
+// Round to the top CAPTURE_PCM_BITS bits, the DSP chain only adds noise below them. Anything that
+// writes samples back into a slot rounds them the same way.
+static inline int32_t capture_quantize(int32_t x) {
+    const int64_t step = 1ll << (32 - CAPTURE_PCM_BITS);
+    int64_t y = ((int64_t)x + step / 2) & ~(step - 1);
+    return y > INT32_MAX ? (int32_t)(INT32_MAX & ~(step - 1)) : (int32_t)y;
+}
+
+// Silence whatever was not filled, apply the fades at both ends of the take and round the samples
+// to CAPTURE_PCM_BITS, which leaves the low bits zero for the slot codec to drop.
+void capture_finish(capture_t *cap);
+
+// Print how long the conversion pass took per block against the time one block takes to arrive.
+void capture_print_stats(const capture_t *cap, uint32_t sample_rate);
+
+#endif
@@ -0,0 +1,111 @@
+/** COMP3601 Design Project A
+ * File name: composition.c
+ * Description: Copy-on-write composition with epoch based reclamation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "composition.h"
+
+int composition_init(composition_t *comp, const song_t *song, const float *gains) {
+    memset(comp, 0, sizeof(composition_t));
+    composition_snapshot_t *snap = (composition_snapshot_t *)calloc(1, sizeof(composition_snapshot_t));
+    if (snap == NULL) {
+        fprintf(stderr, "Unable to allocate enough memory\n");
+        return -1;
+    }
+    snap->song = *song;
+    for (int t = 0; t < PATTERN_MAX_TRACKS; t++) {
+        snap->gains[t] = gains != NULL ? gains[t] : 1.0f;
+    }
+    snap->version = 1;
+
+    comp->current = snap;
+    comp->epoch = 1;
+    pthread_mutex_init(&comp->write_lock, NULL);
+    return 0;
+}
+
+static void free_retired(composition_snapshot_t *snap) {
+    while (snap != NULL) {
+        composition_snapshot_t *next = snap->retired_next;
+        free(snap);
+        snap = next;
+    }
+}
+
+void composition_destroy(composition_t *comp) {
+    // every reader must be done by now
+    free_retired(comp->retired);
+    free(comp->current);
+    comp->retired = NULL;
+    comp->current = NULL;
+    pthread_mutex_destroy(&comp->write_lock);
+}
+
+int composition_register_reader(composition_t *comp) {
+    pthread_mutex_lock(&comp->write_lock);
+    int reader = comp->num_readers < COMPOSITION_MAX_READERS ? comp->num_readers++ : -1;
+    pthread_mutex_unlock(&comp->write_lock);
+    return reader;
+}
+
+composition_snapshot_t *composition_write_begin(composition_t *comp) {
+    pthread_mutex_lock(&comp->write_lock);
+    composition_snapshot_t *next = (composition_snapshot_t *)malloc(sizeof(composition_snapshot_t));
+    if (next == NULL) {
+        fprintf(stderr, "Unable to allocate enough memory\n");
+        pthread_mutex_unlock(&comp->write_lock);
+        return NULL;
+    }
+    *next = *comp->current;
+    next->retired_next = NULL;
+    return next;
+}
+
+void composition_write_abort(composition_t *comp, composition_snapshot_t *next) {
+    free(next);
+    pthread_mutex_unlock(&comp->write_lock);
+}
+
+static void reclaim(composition_t *comp) {
+    // A reader that entered at epoch E may hold anything retired at E or later.
+    // Everything retired before the oldest active reader's epoch is unreachable.
+    uint64_t oldest = __atomic_load_n(&comp->epoch, __ATOMIC_SEQ_CST);
+    for (int r = 0; r < comp->num_readers; r++) {
+        uint64_t e = __atomic_load_n(&comp->readers[r].epoch, __ATOMIC_SEQ_CST);
+        if (e != 0 && e < oldest) {
+            oldest = e;
+        }
+    }
+
+    composition_snapshot_t **link = &comp->retired;
+    while (*link != NULL) {
+        composition_snapshot_t *snap = *link;
+        if (snap->retired_epoch < oldest) {
+            *link = snap->retired_next;
+            free(snap);
+        } else {
+            link = &snap->retired_next;
+        }
+    }
+}
+
+uint64_t composition_publish(composition_t *comp, composition_snapshot_t *next) {
+    composition_snapshot_t *old = comp->current;
+    next->version = old->version + 1;
+    next->retired_next = NULL;
+    __atomic_store_n(&comp->current, next, __ATOMIC_SEQ_CST);
+
+    // readers entering from here on can only see next
+    old->retired_epoch = __atomic_fetch_add(&comp->epoch, 1, __ATOMIC_SEQ_CST);
+    old->retired_next = comp->retired;
+    comp->retired = old;
+    reclaim(comp);
+
+    uint64_t version = next->version;
+    pthread_mutex_unlock(&comp->write_lock);
+    return version;
+}
@@ -0,0 +1,88 @@
+/** COMP3601 Design Project A
+ * File name: composition.h
+ * Description: Versioned, copy-on-write composition shared between the control loop and the
+ * 	readers that have a reader slot (the renderer and the state server). The session saver does not
+ * 	read it, the control loop hands it copies.
+ * 	The current version is an immutable snapshot behind one pointer. A writer copies it, changes
+ * 	the copy and swaps the pointer, so readers never see a half made change and never wait.
+ * 	Old snapshots are freed once every reader that might still hold one has left its read section
+ * 	(epoch based reclamation, like RCU).
+ *
+ * 	Reading, from any thread with its own reader slot:
+ * 		const composition_snapshot_t *snap = composition_read_begin(comp, reader);
+ * 		... use snap, it does not change ...
+ * 		composition_read_end(comp, reader);
+ *
+ * 	Writing, from one thread at a time:
+ * 		composition_snapshot_t *next = composition_write_begin(comp);
+ * 		pattern_toggle(&next->song.patterns[p], track, step);
+ * 		composition_publish(comp, next);
+ */
+
+#ifndef COMPOSITION_H
+#define COMPOSITION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "pattern.h"
+
+#define COMPOSITION_MAX_READERS 8
+
+typedef struct composition_snapshot {
+    song_t song;
+    float gains[PATTERN_MAX_TRACKS];        // mix gain per track
+    uint64_t version;                       // increases by one with every publish
+
+    struct composition_snapshot *retired_next;
+    uint64_t retired_epoch;
+} composition_snapshot_t;
+
+typedef struct {
+    uint64_t epoch;         // global epoch when the read section started, 0 outside one
+    char pad[56];           // one reader per cache line, readers never write each other's lines
+} composition_reader_t;
+
+typedef struct {
+    composition_snapshot_t *current;
+    uint64_t epoch;
+    composition_reader_t readers[COMPOSITION_MAX_READERS];
+    int num_readers;
+
+    pthread_mutex_t write_lock;
+    composition_snapshot_t *retired;        // replaced snapshots waiting for readers to move on
+} composition_t;
+
+// Start from a copy of song with the given gains (NULL for unity). Returns 0 on success, -1 on error.
+int composition_init(composition_t *comp, const song_t *song, const float *gains);
+void composition_destroy(composition_t *comp);
+
+// Give a thread a reader slot. Returns the slot, or -1 if they are all taken.
+int composition_register_reader(composition_t *comp);
+
+// Wait-free: the current snapshot stays valid until the matching composition_read_end.
+static inline const composition_snapshot_t *composition_read_begin(composition_t *comp, int reader) {
+    __atomic_store_n(&comp->readers[reader].epoch, __atomic_load_n(&comp->epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&comp->current, __ATOMIC_SEQ_CST);
+}
+
+static inline void composition_read_end(composition_t *comp, int reader) {
+    __atomic_store_n(&comp->readers[reader].epoch, 0, __ATOMIC_RELEASE);
+}
+
+// The current snapshot for the writing thread. Valid until that thread's next publish.
+static inline const composition_snapshot_t *composition_peek(composition_t *comp) {
+    return __atomic_load_n(&comp->current, __ATOMIC_ACQUIRE);
+}
+
+// A private copy of the current snapshot to change, NULL if out of memory.
+composition_snapshot_t *composition_write_begin(composition_t *comp);
+
+// Make the copy current and give it the next version, returned. Frees snapshots no reader can still see.
+uint64_t composition_publish(composition_t *comp, composition_snapshot_t *next);
+
+// Throw away a copy from composition_write_begin without publishing it.
+void composition_write_abort(composition_t *comp, composition_snapshot_t *next);
+
+#endif
@@ -0,0 +1,144 @@
+/** COMP3601 Design Project A
+ * File name: fft.c
+ * Description: Iterative radix-4 complex FFT (with one radix-2 stage when log2(n) is odd),
+ * 	precomputed twiddle and bit reversal tables.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "fft.h"
+
+fft_plan_t *fft_plan_create(int n) {
+    if (n < 2 || (n & (n - 1)) != 0) {
+        return NULL;
+    }
+
+    fft_plan_t *plan = (fft_plan_t *)malloc(sizeof(fft_plan_t));
+    if (plan == NULL) {
+        return NULL;
+    }
+    plan->n = n;
+    plan->bitrev = (int *)malloc(n * sizeof(int));
+    plan->tw_re = (float *)malloc(n * sizeof(float));
+    plan->tw_im = (float *)malloc(n * sizeof(float));
+    if (plan->bitrev == NULL || plan->tw_re == NULL || plan->tw_im == NULL) {
+        fft_plan_destroy(plan);
+        return NULL;
+    }
+
+    int bits = 0;
+    while ((1 << bits) < n) {
+        bits++;
+    }
+    for (int i = 0; i < n; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++) {
+            if (i & (1 << b)) {
+                r |= 1 << (bits - 1 - b);
+            }
+        }
+        plan->bitrev[i] = r;
+    }
+
+    // One radix-2 stage first if the size is not a power of four, then radix-4 stages that each
+    // combine blocks of m into blocks of 4m. A stage's twiddles W^k, W^2k, W^3k (W = e^(i*2*pi/4m),
+    // k < m) are stored as three runs of m, so the butterfly loop reads them in order.
+    plan->radix2 = bits % 2;
+    int pos = 0;
+    for (int m = plan->radix2 ? 2 : 1; 4 * m <= n; m *= 4) {
+        for (int j = 1; j <= 3; j++) {
+            for (int k = 0; k < m; k++) {
+                double angle = 2.0 * M_PI * j * k / (4 * m);
+                plan->tw_re[pos] = (float)cos(angle);
+                plan->tw_im[pos] = (float)sin(angle);
+                pos++;
+            }
+        }
+    }
+
+    return plan;
+}
+
+void fft_plan_destroy(fft_plan_t *plan) {
+    if (plan == NULL) {
+        return;
+    }
+    free(plan->bitrev);
+    free(plan->tw_re);
+    free(plan->tw_im);
+    free(plan);
+}
+
+// Combine four blocks of m into one of 4m. The blocks are disjoint and the loop has no branches,
+// so the compiler can vectorise it across k.
+static void radix4(int m, float sign, float *__restrict r0, float *__restrict r1, float *__restrict r2, float *__restrict r3,
+                   float *__restrict i0, float *__restrict i1, float *__restrict i2, float *__restrict i3,
+                   const float *__restrict wr, const float *__restrict wi) {
+    for (int k = 0; k < m; k++) {
+        // after bit reversal the second block pairs with the first at W^2k (the radix-2
+        // stage for 2m), the third and fourth come in at W^k and W^3k
+        float c1 = wr[m + k], s1 = sign * wi[m + k];
+        float c2 = wr[k], s2 = sign * wi[k];
+        float c3 = wr[2 * m + k], s3 = sign * wi[2 * m + k];
+        float b1r = r1[k] * c1 - i1[k] * s1, b1i = r1[k] * s1 + i1[k] * c1;
+        float b2r = r2[k] * c2 - i2[k] * s2, b2i = r2[k] * s2 + i2[k] * c2;
+        float b3r = r3[k] * c3 - i3[k] * s3, b3i = r3[k] * s3 + i3[k] * c3;
+
+        float t0r = r0[k] + b1r, t0i = i0[k] + b1i;
+        float t1r = r0[k] - b1r, t1i = i0[k] - b1i;
+        float t2r = b2r + b3r, t2i = b2i + b3i;
+        float t3r = b2r - b3r, t3i = b2i - b3i;
+
+        // the odd outputs turn t3 by a quarter, -i forward and +i inverse
+        r0[k] = t0r + t2r;
+        i0[k] = t0i + t2i;
+        r2[k] = t0r - t2r;
+        i2[k] = t0i - t2i;
+        r1[k] = t1r - sign * t3i;
+        i1[k] = t1i + sign * t3r;
+        r3[k] = t1r + sign * t3i;
+        i3[k] = t1i - sign * t3r;
+    }
+}
+
+void fft_execute(const fft_plan_t *plan, float *re, float *im, bool inverse) {
+    int n = plan->n;
+
+    // reorder the input so the butterflies can run in place
+    for (int i = 0; i < n; i++) {
+        int j = plan->bitrev[i];
+        if (j > i) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+
+    int m = 1;
+    if (plan->radix2) {
+        // pairs, every twiddle is 1
+        for (int a = 0; a < n; a += 2) {
+            float tr = re[a + 1];
+            float ti = im[a + 1];
+            re[a + 1] = re[a] - tr;
+            im[a + 1] = im[a] - ti;
+            re[a] += tr;
+            im[a] += ti;
+        }
+        m = 2;
+    }
+
+    // forward transform uses e^(-i*theta), inverse uses e^(+i*theta)
+    float sign = inverse ? 1.0f : -1.0f;
+    const float *tw_re = plan->tw_re;
+    const float *tw_im = plan->tw_im;
+    for (; 4 * m <= n; m *= 4) {
+        for (int start = 0; start < n; start += 4 * m) {
+            float *r = re + start;
+            float *i = im + start;
+            radix4(m, sign, r, r + m, r + 2 * m, r + 3 * m, i, i + m, i + 2 * m, i + 3 * m, tw_re, tw_im);
+        }
+        tw_re += 3 * m;
+        tw_im += 3 * m;
+    }
+}
@@ -0,0 +1,27 @@
+/** COMP3601 Design Project A
+ * File name: fft.h
+ * Description: Small complex FFT used by the time-stretch correlation and the input meter's spectrum.
+ */
+
+#ifndef FFT_H
+#define FFT_H
+
+#include <stdbool.h>
+
+typedef struct {
+    int n;          // transform size, must be a power of two
+    int *bitrev;    // bit reversed index table (n entries)
+    bool radix2;    // log2(n) is odd, the first stage is radix-2
+    float *tw_re;   // twiddle factors of each radix-4 stage in the order they are used, under n entries
+    float *tw_im;
+} fft_plan_t;
+
+// Allocate the tables for a transform of size n. Returns NULL if n is not a power of two or on allocation failure.
+fft_plan_t *fft_plan_create(int n);
+void fft_plan_destroy(fft_plan_t *plan);
+
+// In place complex FFT on split real/imaginary arrays of plan->n entries.
+// The inverse transform is not scaled by 1/n.
+void fft_execute(const fft_plan_t *plan, float *re, float *im, bool inverse);
+
+#endif
@@ -0,0 +1,238 @@
+/** COMP3601 Design Project A
+ * File name: led_link.c
+ * Description: Non-blocking, batched connection to the arduino controller.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "led_link.h"
+
+static long ms_until(const struct timespec *t) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (t->tv_sec - now.tv_sec) * 1000 + (t->tv_nsec - now.tv_nsec) / 1000000;
+}
+
+static void disconnect(led_link_t *link) {
+    // Drop the connection and schedule the next attempt, backing off while the controller stays away
+    if (link->fd >= 0) {
+        close(link->fd);
+        link->fd = -1;
+    }
+    if (link->state == LED_LINK_UP) {
+        printf("Lost the controller, reconnecting\n");
+        link->reconnects++;
+    }
+    link->state = LED_LINK_DOWN;
+    link->out_len = 0;
+    link->out_sent = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &link->retry_at);
+    link->retry_at.tv_sec += link->backoff_ms / 1000;
+    link->retry_at.tv_nsec += (link->backoff_ms % 1000) * 1000000L;
+    if (link->retry_at.tv_nsec >= 1000000000L) {
+        link->retry_at.tv_sec++;
+        link->retry_at.tv_nsec -= 1000000000L;
+    }
+    link->backoff_ms = link->backoff_ms * 2 > LED_LINK_RETRY_MAX_MS ? LED_LINK_RETRY_MAX_MS : link->backoff_ms * 2;
+}
+
+static void connected(led_link_t *link) {
+    link->state = LED_LINK_UP;
+    link->backoff_ms = LED_LINK_RETRY_MIN_MS;
+    printf("Connected to the controller at %s:%u\n", link->host, link->port);
+
+    // the controller may have restarted, so send it the latest state of every key again
+    for (int k = 0; k < LED_LINK_KEYS; k++) {
+        if (link->msg_len[k] > 0 && link->msg_seq[k] == 0) {
+            link->msg_seq[k] = ++link->seq;
+        }
+    }
+}
+
+static void start_connect(led_link_t *link) {
+    struct sockaddr_in server;
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_port = htons(link->port);
+    if (inet_pton(AF_INET, link->host, &server.sin_addr) != 1) {
+        fprintf(stderr, "Bad controller address %s\n", link->host);
+        disconnect(link);
+        return;
+    }
+
+    link->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (link->fd < 0) {
+        perror("socket");
+        disconnect(link);
+        return;
+    }
+    // LED updates are tiny, send them straight away rather than waiting to fill a segment
+    int one = 1;
+    setsockopt(link->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (connect(link->fd, (struct sockaddr *)&server, sizeof(server)) == 0) {
+        connected(link);
+    } else if (errno == EINPROGRESS) {
+        link->state = LED_LINK_CONNECTING;
+    } else {
+        disconnect(link);
+    }
+}
+
+static void flush(led_link_t *link) {
+    // Write as much as the socket takes without blocking, whatever is left goes on the next call
+    while (link->state == LED_LINK_UP) {
+        if (link->out_sent == link->out_len) {
+            // batch every pending key, oldest update first
+            link->out_len = 0;
+            link->out_sent = 0;
+            while (true) {
+                int next = -1;
+                for (int k = 0; k < LED_LINK_KEYS; k++) {
+                    if (link->msg_seq[k] != 0 && (next < 0 || link->msg_seq[k] < link->msg_seq[next])) {
+                        next = k;
+                    }
+                }
+                if (next < 0) {
+                    break;
+                }
+                memcpy(link->out + link->out_len, link->msg[next], link->msg_len[next]);
+                link->out_len += link->msg_len[next];
+                link->msg_seq[next] = 0;
+            }
+            if (link->out_len == 0) {
+                return;
+            }
+        }
+
+        ssize_t n = send(link->fd, link->out + link->out_sent, link->out_len - link->out_sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                disconnect(link);
+            }
+            return;
+        }
+        link->out_sent += n;
+    }
+}
+
+void led_link_init(led_link_t *link, const char *host, uint16_t port) {
+    memset(link, 0, sizeof(led_link_t));
+    snprintf(link->host, sizeof(link->host), "%s", host);
+    link->port = port;
+    link->fd = -1;
+    link->state = LED_LINK_DOWN;
+    link->backoff_ms = LED_LINK_RETRY_MIN_MS;
+    start_connect(link);
+}
+
+void led_link_send(led_link_t *link, int key, const char *msg, size_t len) {
+    if (key < 0 || key >= LED_LINK_KEYS || len > LED_LINK_MSG_MAX) {
+        return;
+    }
+    if (link->msg_seq[key] != 0) {
+        link->replaced++;
+    }
+    memcpy(link->msg[key], msg, len);
+    link->msg_len[key] = len;
+    if (++link->seq == 0) {
+        link->seq = 1;
+    }
+    link->msg_seq[key] = link->seq;
+    flush(link);
+}
+
+static bool pending(const led_link_t *link) {
+    if (link->out_sent < link->out_len) {
+        return true;
+    }
+    for (int k = 0; k < LED_LINK_KEYS; k++) {
+        if (link->msg_seq[k] != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int led_link_pollfd(const led_link_t *link, struct pollfd *pfd, int max_ms) {
+    pfd->fd = link->fd;
+    pfd->events = 0;
+    pfd->revents = 0;
+
+    switch (link->state) {
+        case LED_LINK_DOWN: {
+            long wait = ms_until(&link->retry_at);
+            return wait < 0 ? 0 : (wait < max_ms ? (int)wait : max_ms);
+        }
+        case LED_LINK_CONNECTING:
+            pfd->events = POLLOUT;
+            break;
+        case LED_LINK_UP:
+            pfd->events = POLLIN | (pending(link) ? POLLOUT : 0);
+            break;
+    }
+    return max_ms;
+}
+
+int led_link_service(led_link_t *link, short revents, char *buf, size_t size) {
+    int received = 0;
+    if (size > 0) {
+        buf[0] = '\0';
+    }
+
+    if (link->state == LED_LINK_DOWN) {
+        if (ms_until(&link->retry_at) <= 0) {
+            start_connect(link);
+        }
+        return 0;
+    }
+
+    if (link->state == LED_LINK_CONNECTING) {
+        if (!(revents & (POLLOUT | POLLERR | POLLHUP))) {
+            return 0;
+        }
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(link->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+            disconnect(link);
+            return 0;
+        }
+        connected(link);
+    }
+
+    if (revents & POLLIN) {
+        ssize_t n = recv(link->fd, buf, size - 1, MSG_DONTWAIT);
+        if (n > 0) {
+            buf[n] = '\0';
+            received = n;
+        } else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            disconnect(link);
+            return 0;
+        }
+    } else if (revents & (POLLERR | POLLHUP)) {
+        disconnect(link);
+        return 0;
+    }
+
+    flush(link);
+    return received;
+}
+
+void led_link_close(led_link_t *link) {
+    if (link->fd >= 0) {
+        close(link->fd);
+        link->fd = -1;
+    }
+    link->state = LED_LINK_DOWN;
+}
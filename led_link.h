@@ -0,0 +1,74 @@
+/** COMP3601 Design Project A
+ * File name: led_link.h
+ * Description: Connection to the arduino controller. LED updates are queued and written from a
+ * 	non-blocking socket, so a slow or missing controller never holds up recording or rendering.
+ * 	Each message has a key and only the latest message per key is kept, older ones are replaced
+ * 	before they are sent. The connection is re-established automatically with a bounded backoff.
+ */
+
+#ifndef LED_LINK_H
+#define LED_LINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <time.h>
+#include <poll.h>
+
+#define LED_LINK_KEYS 4                 // independent message streams
+#define LED_LINK_MSG_MAX 64             // longest message
+#define LED_LINK_RETRY_MIN_MS 100       // reconnect backoff, doubled after each failure
+#define LED_LINK_RETRY_MAX_MS 5000
+
+// Message keys
+#define LED_LINK_KEY_LEDS 0             // "(xxxxxxxx)" timeline LEDs
+#define LED_LINK_KEY_READY 1            // "{1}" / "{0}" render ready LED on / off
+
+typedef enum {
+    LED_LINK_DOWN,
+    LED_LINK_CONNECTING,
+    LED_LINK_UP
+} led_link_state_t;
+
+typedef struct {
+    char host[64];
+    uint16_t port;
+    int fd;
+    led_link_state_t state;
+
+    // latest message per key, and whether it still has to be sent
+    char msg[LED_LINK_KEYS][LED_LINK_MSG_MAX];
+    uint8_t msg_len[LED_LINK_KEYS];
+    uint32_t msg_seq[LED_LINK_KEYS];    // order the keys were updated in, 0 = nothing pending
+    uint32_t seq;
+
+    // the batch being written, out_sent of out_len bytes are on the wire
+    char out[LED_LINK_KEYS * LED_LINK_MSG_MAX];
+    size_t out_len;
+    size_t out_sent;
+
+    int backoff_ms;
+    struct timespec retry_at;
+
+    uint32_t replaced;                  // messages collapsed into a newer one before being sent
+    uint32_t reconnects;
+} led_link_t;
+
+// Set up the link to host:port and start connecting. Never blocks.
+void led_link_init(led_link_t *link, const char *host, uint16_t port);
+
+// Queue a message under key, replacing anything not yet sent under the same key. Never blocks.
+void led_link_send(led_link_t *link, int key, const char *msg, size_t len);
+
+// For callers polling several descriptors: fills in pfd (fd is -1 while disconnected) and
+// returns how long, in ms, the caller may sleep before led_link_service must run again.
+int led_link_pollfd(const led_link_t *link, struct pollfd *pfd, int max_ms);
+
+// Handle the poll result for the link: finish connecting, write what the socket will take,
+// reconnect if it is time. Data from the controller is copied to buf (NUL terminated) and its
+// length returned, 0 if nothing arrived.
+int led_link_service(led_link_t *link, short revents, char *buf, size_t size);
+
+void led_link_close(led_link_t *link);
+
+#endif
@@ -32,6 +32,22 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <termios.h>
+#include <getopt.h>
+#include <errno.h>
+#include <pthread.h>
+#include "time_stretch.h"
+#include "pattern.h"
+#include "capture.h"
+#include "slot_codec.h"
+#include "session.h"
+#include "led_link.h"
+#include "state_server.h"
+#include "render_worker.h"
+#include "composition.h"
+#include "axi_dma_mm2s.h"
+#include "playback.h"
+#include "overdub.h"
+#include "meter.h"
 
 
 
@@ -40,7 +56,19 @@
 #define SAMPLE_RATE  41000// 44100
 #define RECORD_DURATION 0.5 /* 0.5 second buffer, because each time step is half a second */
 #define BUF_SIZE int(SAMPLE_RATE * RECORD_DURATION)
-#define TRANSFER_RUNS int(SAMPLE_RATE * RECORD_DURATION / 128) + 50
+#define RECORD_PACKET_LEN 1024 // words per DMA block while recording, left and right interleaved so half are samples
+#define TRANSFER_RUNS ((BUF_SIZE + RECORD_PACKET_LEN / 2 - 1) / (RECORD_PACKET_LEN / 2))
+#define ARM_TIMEOUT 3.0 // seconds to wait for a sound before recording anyway
+#define NUM_SLOTS PATTERN_MAX_TRACKS // one recorded sound per track
+#define NUM_LEDS 8 // timeline LEDs/buttons on the controller
+#define CONTROLLER_ADDR "192.168.1.177" // the ip address chosen for the server in the arduino code
+#define CONTROLLER_PORT 80 // port 80 like the arduino server
+#define STATE_SERVER_PORT 3601 // default port for extra controllers and monitors (-l)
+#define POLL_INTERVAL_MS 100 // longest the control loop waits for the controller before doing other things
+#define SLOT_CACHE_TEMPOS 4 // how many step lengths (tempos) we keep a fitted copy of for each slot
+#define OVERDUB_COUNT_IN 1.0 // seconds of count-in before an overdub, its click measures the latency
+#define DMA_BLOCK_TIMEOUT_MS 250 // longest an overdub waits for one capture block, or playback for one period, before giving up
+#define METER_LED_STEP_DB 6.0f // the input level bar lights one more LED every 6dB, from -48dBFS with 8 LEDs
 
 
 typedef struct {
@@ -159,141 +187,185 @@ void append_wav_files(WavFile *wav1, WavFile *wav2, WavFile *output) {
 }
 
 
-// get empty sound chunk
-void generate_silent_wav(const char *filename, float duration_sec) {
-    WavFile silent_wav;
-
-    // Fill the header information
-    memcpy(silent_wav.chunkId, "RIFF", 4);
-    silent_wav.chunkSize = 36 + 41000 * duration_sec * 4; // Duration is calculated as sampleRate * seconds * bytesPerSample
-    memcpy(silent_wav.format, "WAVE", 4);
-    memcpy(silent_wav.subchunk1Id, "fmt ", 4);
-    silent_wav.subchunk1Size = 16;
-    silent_wav.audioFormat = 1;
-    silent_wav.numChannels = 1;
-    silent_wav.sampleRate = 41000;
-    silent_wav.byteRate = 164000;
-    silent_wav.blockAlign = 4;
-    silent_wav.bitsPerSample = 32;
-    memcpy(silent_wav.subchunk2Id, "data", 4);
-    silent_wav.subchunk2Size = 41000 * duration_sec * 4; // Duration is calculated as sampleRate * seconds * bytesPerSample
-
-    // Allocate memory for data
-    silent_wav.data = (int32_t*)malloc(silent_wav.subchunk2Size);
-    if (silent_wav.data == NULL) {
-        fprintf(stderr, "Unable to allocate enough memory\n");
-        return;
-    }
-
-    // Fill the data with zeros
-    memset(silent_wav.data, 0, silent_wav.subchunk2Size);
+void init_wav_header(WavFile *wav, uint32_t num_samples) {
+    // Fill the header information for a mono 32 bit file of num_samples samples
+    memcpy(wav->chunkId, "RIFF", 4);
+    wav->chunkSize = 36 + num_samples * 4;
+    memcpy(wav->format, "WAVE", 4);
+    memcpy(wav->subchunk1Id, "fmt ", 4);
+    wav->subchunk1Size = 16;
+    wav->audioFormat = 1;
+    wav->numChannels = 1;
+    wav->sampleRate = SAMPLE_RATE;
+    wav->byteRate = SAMPLE_RATE * 4;
+    wav->blockAlign = 4;
+    wav->bitsPerSample = 32;
+    memcpy(wav->subchunk2Id, "data", 4);
+    wav->subchunk2Size = num_samples * 4;
+    wav->data = NULL;
+}
 
-    // Write the silent wav file
-    write_wav_file(filename, &silent_wav);
+typedef struct {
+    uint32_t stepLen;   // 0 when the entry is unused
+    uint32_t lastUsed;
+    int32_t *data;      // the recording fitted to exactly stepLen samples
+} FittedSlot;
 
-    // Free the allocated memory
-    free(silent_wav.data);
+typedef struct {
+    uint32_t rawLen;    // 0 when the slot has not been loaded
+    int32_t *raw;       // the recording as it was captured
+    FittedSlot fitted[SLOT_CACHE_TEMPOS];
+} SlotCache;
+
+// Recorded sounds and their time-stretched copies, so a tempo change does not need re-recording
+SlotCache slotCache[NUM_SLOTS] = {};
+uint32_t slotCacheClock = 0;
+// Held by the render worker while it mixes, and by anything replacing a slot's sound
+pthread_mutex_t slotCacheLock = PTHREAD_MUTEX_INITIALIZER;
+// Held while a slot's .slc is written, so an overdub saved in the background cannot land on top of a new recording
+pthread_mutex_t slotFileLock = PTHREAD_MUTEX_INITIALIZER;
+
+// The song and track gains. Written only by the control loop, every change publishes a new version
+// that the renderer and the state server read without locking. Renders are tagged with the version
+composition_t composition;
+int renderReader = -1;     // the renderer's reader slot, also used by the control loop while the worker is idle
+
+void invalidateSlot(int slot) {
+    // Drop everything cached for a slot, called when the slot is re-recorded
+    pthread_mutex_lock(&slotCacheLock);
+    SlotCache *cache = &slotCache[slot];
+    free(cache->raw);
+    for (int k = 0; k < SLOT_CACHE_TEMPOS; k++) {
+        free(cache->fitted[k].data);
+    }
+    memset(cache, 0, sizeof(SlotCache));
+    pthread_mutex_unlock(&slotCacheLock);
 }
 
-WavFile renderColumn(bool composition[4][8], int j) {
-    //create the sound for one column of the composition using the recorded sounds, depending on which sounds are active in that column of the composition array
-    WavFile wav0;
-    WavFile wav1;
-    WavFile wav2;
-    WavFile wav3;
-    WavFile output1;
-    WavFile output2;
-    WavFile output3;
-
-
-
-    // i - row max 4
-    // j - column max 8
-    int i = 0;
-    while (i < 4) {
-        if (composition[i][j]) {
-            // snprintf(test, sizeof(test), "test%d.wav", i);
-            if (i == 0) read_wav_file("0.wav", &wav0);
-            else if (i == 1) read_wav_file("1.wav", &wav1);
-            else if (i == 2) read_wav_file("2.wav", &wav2);
-            else if (i == 3) read_wav_file("3.wav", &wav3);
+const int32_t *getFittedSlot(int slot, uint32_t stepLen) {
+    // Returns the sound in a slot fitted to exactly stepLen samples, or NULL if the slot has no recording
+    // The caller holds slotCacheLock for as long as it uses the sound
+    SlotCache *cache = &slotCache[slot];
+    slotCacheClock++;
+
+    for (int k = 0; k < SLOT_CACHE_TEMPOS; k++) {
+        if (cache->fitted[k].stepLen == stepLen) {
+            cache->fitted[k].lastUsed = slotCacheClock;
+            return cache->fitted[k].data;
+        }
+    }
+
+    if (cache->rawLen == 0) {
+        char filename[20];
+        sprintf(filename, "%d.slc", slot);
+        uint32_t rawLen, rate;
+        int32_t *raw = slot_codec_read(filename, &rawLen, &rate);
+        if (raw != NULL) {
+            cache->raw = raw;
+            cache->rawLen = rawLen;
         } else {
-            if (i == 0) read_wav_file("none.wav", &wav0);
-            else if (i == 1) read_wav_file("none.wav", &wav1);
-            else if (i == 2) read_wav_file("none.wav", &wav2);
-            else if (i == 3) read_wav_file("none.wav", &wav3);
+            // recordings made before the .slc format
+            sprintf(filename, "%d.wav", slot);
+            WavFile wav = {};
+            read_wav_file(filename, &wav);
+            if (wav.data == NULL || wav.subchunk2Size < 8) {
+                free(wav.data);
+                return NULL;
+            }
+            // read_wav_file leaves the final sample unread
+            cache->raw = wav.data;
+            cache->rawLen = wav.subchunk2Size / 4 - 1;
         }
-        i++;
     }
-    // overlap them
-    overlap_wav_files(&wav0, &wav1, &output1);
 
-    overlap_wav_files(&output1, &wav2, &output2);
-    overlap_wav_files(&output2, &wav3, &output3);
-    return output3;
-}
+    // replace an empty or the least recently used entry
+    FittedSlot *entry = &cache->fitted[0];
+    for (int k = 1; k < SLOT_CACHE_TEMPOS; k++) {
+        if (cache->fitted[k].lastUsed < entry->lastUsed) {
+            entry = &cache->fitted[k];
+        }
+    }
 
-WavFile joinColumns(WavFile *Cols) {
-    //join together all 8 columns
-
-    WavFile wav0;
-    WavFile wav1;
-    WavFile wav2;
-    WavFile wav3;
-    WavFile wav4;
-    WavFile wav5;
-    WavFile wav6;
-    WavFile wav7;
-    WavFile output1;
-    WavFile output2;
-    WavFile output3;
-    WavFile output4;
-    WavFile output11;
-    WavFile output12;
-    WavFile output;
-
-
-    // i - row max 4
-    // j - column max 8
-    int i = 0;
-    while (i < 8) {
-        if (i == 0) append_wav_files(&Cols[i], &Cols[i + 1], &output1);
-        else if (i == 2) append_wav_files(&Cols[i], &Cols[i + 1], &output2);
-        else if (i == 4) append_wav_files(&Cols[i], &Cols[i + 1], &output3);
-        else if (i == 6) append_wav_files(&Cols[i], &Cols[i + 1], &output4);
-        i = i + 2;
-    }
-    i = 0;
-    while (i < 4) {
-        if (i == 0) append_wav_files(&output1, &output2, &output11);
-        else if (i == 2) append_wav_files(&output3, &output4, &output12);
-        i = i + 2;
-    }
-    // add them
-    append_wav_files(&output11, &output12, &output);
-    return output;
+    int32_t *data = time_stretch_fit(cache->raw, cache->rawLen, stepLen);
+    if (data == NULL) {
+        fprintf(stderr, "Unable to fit slot %d to %u samples\n", slot, stepLen);
+        return NULL;
+    }
+    free(entry->data);
+    entry->data = data;
+    entry->stepLen = stepLen;
+    entry->lastUsed = slotCacheClock;
+    return data;
 }
 
-void makeFinalWav(bool composition[4][8]){
-    // Renders the final .wav file using the composition array and the 4 recorded sounds
-    WavFile output;
+void dropFittedSlot(int slot) {
+    // Drop the fitted copies but keep the recording, after it was changed in place
+    // The caller holds slotCacheLock
+    SlotCache *cache = &slotCache[slot];
+    for (int k = 0; k < SLOT_CACHE_TEMPOS; k++) {
+        free(cache->fitted[k].data);
+        memset(&cache->fitted[k], 0, sizeof(FittedSlot));
+    }
+}
 
-    // Generate a silent wav file to use when a sound is not active in a timestep
-    generate_silent_wav("none.wav", RECORD_DURATION);
+int32_t *renderSong(render_worker_t *worker, const render_job_t *job, uint32_t *len){
+    // Renders the final mix from the song (its chain of patterns) and the recorded sounds, on the render worker.
+    // Only the active cells are visited, so the cost grows with the number of notes rather than the size of the grid
+    // Gives up (returns NULL) as soon as a newer version of the composition is submitted
+    const composition_snapshot_t *snap = composition_read_begin(&composition, renderReader);
+    if (snap->version != job->version) {
+        // already out of date, the newer version is on its way
+        composition_read_end(&composition, renderReader);
+        return NULL;
+    }
+    const song_t *song = &snap->song;
+    const float *gains = snap->gains;
+    uint32_t stepLen = song_step_samples(song, SAMPLE_RATE);
+    uint32_t patternLen = stepLen * song->num_steps;
+    uint64_t stepMask = song_step_mask(song);
+
+    int32_t *output = (int32_t *)calloc(patternLen * song->chain_len, sizeof(int32_t));
+    if (output == NULL) {
+        fprintf(stderr, "Unable to allocate enough memory\n");
+        composition_read_end(&composition, renderReader);
+        return NULL;
+    }
 
-    // loop through the columns of the composition and stack the wav files depending on what sounds are active
-    int j = 0;
-    WavFile Cols[8] = {};
-    while (j < 8) {
-        Cols[j] = renderColumn(composition, j);
-        j++;
+    pthread_mutex_lock(&slotCacheLock);
+    for (int t = 0; t < song->num_tracks; t++) {
+        // fetched on the first active cell, so tracks without notes are never loaded or fitted
+        const int32_t *sound = NULL;
+        bool missing = false;
+        // scaled so every track playing at once at unity gain cannot overflow
+        float scale = gains[t] / song->num_tracks;
+
+        for (int c = 0; c < song->chain_len && !missing; c++) {
+            uint64_t bits = song->patterns[song->chain[c]].tracks[t] & stepMask;
+            while (bits) {
+                int step = pattern_pop_step(&bits);
+                if (worker != NULL && render_worker_cancelled(worker, job)) {
+                    pthread_mutex_unlock(&slotCacheLock);
+                    composition_read_end(&composition, renderReader);
+                    free(output);
+                    return NULL;
+                }
+                if (sound == NULL && (sound = getFittedSlot(t, stepLen)) == NULL) {
+                    missing = true;
+                    break;
+                }
+                int32_t *dst = output + c * patternLen + step * stepLen;
+                for (uint32_t s = 0; s < stepLen; s++) {
+                    dst[s] += (int32_t)(sound[s] * scale);
+                }
+            }
+        }
     }
 
-    //join together the columns
-    output = joinColumns(Cols);
+    pthread_mutex_unlock(&slotCacheLock);
 
-    //write to output.wav
-    write_wav_file("output.wav", &output);
+    *len = patternLen * song->chain_len;
+    composition_read_end(&composition, renderReader);
+    return output;
 }
 
 void bin(uint8_t n) {
@@ -346,21 +418,6 @@ void write_little_endian(unsigned int word, int num_bytes, FILE *wav_file)
     }
 }
 
-// Reverse all the bits we receive
-unsigned int reverseBits(unsigned int num) {
-    unsigned int  numOfBits = sizeof(num) * 8;
-    unsigned int reverseNum = 0;
-    unsigned int i;
-
-    // looping through num of bits
-    for (i = 0; i < numOfBits; i++) {
-        if((num & (1 << i)))
-           reverseNum |= 1 << ((numOfBits - 1) - i);
-    }
-    return reverseNum;
-}
-
-
 // Based on code from https://karplus4arduino.wordpress.com/2011/10/08/making-wav-files-from-c-programs/
 void write_wav(const char * filename, unsigned long num_samples, uint32_t * data, int s_rate)
 {
@@ -410,12 +467,32 @@ void write_wav(const char * filename, unsigned long num_samples, uint32_t * data
     fclose(wav_file);
 }
 
-int getSound(int num) {
-    // This function is used to record a new sound, it is effectively our M3 code, and the parameter is used to decide which sound slot to record to (0.wav, 1.wav, 2.wav, 3.wav)
-    printf("Entered main\n");
+typedef struct {
+    led_link_t *leds;
+    state_server_t *server;     // NULL when not serving
+    int row;                    // selected row, reported with transport changes
+} Outputs;
+
+void publishMeter(Outputs *outputs, const meter_levels_t *levels) {
+    // While recording the timeline LEDs show the input peak as a bar, the other controllers get the full levels
+    char message[NUM_LEDS + 3];  // "(11100000)\n"
+    int lit = (int)((levels->peak_db + NUM_LEDS * METER_LED_STEP_DB) / METER_LED_STEP_DB + 1.0f);
+    message[0] = '(';
+    for (int i = 0; i < NUM_LEDS; i++) {
+        message[i + 1] = i < lit ? '1' : '0';
+    }
+    message[NUM_LEDS + 1] = ')';
+    message[NUM_LEDS + 2] = '\n';
+    led_link_send(outputs->leds, LED_LINK_KEY_LEDS, message, sizeof(message));
 
-    // defining frames, contains TRANSFER_RUNS (10) frames, each frame containing (TRANSFER_LEN) int32's (each represents a 32bit sample)
-    uint32_t frames[TRANSFER_RUNS][TRANSFER_LEN] = {0};
+    if (outputs->server != NULL) {
+        state_server_meter(outputs->server, levels);
+    }
+}
+
+int getSound(int num, Outputs *outputs) {
+    // This function is used to record a new sound, it is effectively our M3 code, and the parameter is used to decide which sound slot to record to (0.slc, 1.slc, 2.slc, 3.slc)
+    printf("Entered main\n");
 
     // initialising audio_i2s and getting the configuration from it
     audio_i2s_t my_config;
@@ -435,224 +512,792 @@ int getSound(int num) {
     printf("After writing to gain: %08x\n", audio_i2s_get_reg(&my_config, AUDIO_I2S_GAIN));
 
 
+    // start from an empty FIFO so the overflow flag and dropped count only cover this take
+    audio_i2s_fifo_reset(&my_config);
+
     printf("Initializesd audio_i2s\n");
     printf("Starting audio_i2s_recv\n");
 
-    // getting the audio data
-    for (int i = 0; i < TRANSFER_RUNS; i++) {
-        // geting TRANSFER_LEN (256) samples (int32's) from i2s/axi/etc
-        int32_t *samples = audio_i2s_recv(&my_config);
-        // writing these samples to a frame in frames
-        memcpy(frames[i], samples, TRANSFER_LEN*sizeof(uint32_t));
+    int32_t buffer[BUF_SIZE];
+
+    // Each DMA block is converted as it arrives. Recording is armed until the onset detector fires,
+    // so the take starts with the sound instead of with whatever was in the air beforehand
+    capture_t cap;
+    capture_init(&cap, buffer, BUF_SIZE, SAMPLE_RATE * ARM_TIMEOUT);
+    // the input level is shown from the moment recording is armed, so the sound can be pitched right
+    meter_t meter;
+    bool metering = meter_init(&meter, SAMPLE_RATE) == 0;
+    if (metering) {
+        capture_set_meter(&cap, &meter);
+    }
+    // the pipeline ends each packet after the same number of words the DMA asks for
+    uint32_t packetLen = audio_i2s_set_packet_len(&my_config, RECORD_PACKET_LEN);
+    int maxRuns = TRANSFER_RUNS + int(SAMPLE_RATE * ARM_TIMEOUT / (packetLen / 2)) + 1;
+    for (int i = 0; i < maxRuns && !capture_done(&cap); i++) {
+        // geting packetLen words from i2s/axi/etc, left and right channel interleaved
+        // only the words the packet actually held are new, the rest is the previous block
+        int32_t *samples = audio_i2s_recv(&my_config, packetLen);
+        capture_block(&cap, (const uint32_t *)samples, audio_i2s_received(&my_config));
+        const meter_levels_t *levels = metering ? meter_take(&meter) : NULL;
+        if (levels != NULL) {
+            publishMeter(outputs, levels);
+        }
     }
 
-    // cleaning up
+    printf("FIFO: level %u, %s, %u samples dropped\n", audio_i2s_fifo_level(&my_config),
+           audio_i2s_fifo_overflowed(&my_config) ? "overflowed" : "no overflow", audio_i2s_fifo_dropped(&my_config));
+
+    // Ensuring proper resource cleanup
+    // releasing hardware components upon task completion
     audio_i2s_release(&my_config);
 
-    uint32_t buffer[BUF_SIZE] = {0};
-
-    // i is loop through frames
-    int i;
-    // t is loop through all bits in each frames
-    int t;
-    // p is increasing when we save bits to buffer
-    int p = 0;
-    // check is checking the first line for output is left channel or right channel
-    int check = 0;
-    // check if the odd line is channel without 0 or nor
-    if (frames[0][0] == 0) {
-        check = 1;
-    }
-
-
-    int startFade1 = BUF_SIZE/8.5 - 40;
-    int endFade1 = BUF_SIZE/8.5;
-    int startFade2 = BUF_SIZE*2 - 40;
-    int endFade2 = BUF_SIZE*2;
-    // save the sound to buffer
-    for (i = 0; i < TRANSFER_RUNS; i++) {
-        for (t = 0; t < TRANSFER_LEN; t++) {
-            if (t % 2 == check) {
-                if (p < BUF_SIZE){
-                    // when save into buffer, need to be reverse bits first
-                    buffer[p] = reverseBits(frames[i][t]);
-                    if (buffer[p] == 0){
-                        buffer[p] = buffer[p-1];
-                    }
-                }
-                p++;
-            }
+    // silence any unfilled tail and fade both ends so the sound does not click
+    capture_finish(&cap);
+    capture_print_stats(&cap, SAMPLE_RATE);
+    if (metering) {
+        meter_print_stats(&meter, SAMPLE_RATE);
+        meter_destroy(&meter);
+    }
+
+    // save the take compressed, the samples are 18 bit so it is well under half the size of a 32 bit .wav
+    char filename[20];
+    sprintf(filename, "%d.slc", num);
+    pthread_mutex_lock(&slotFileLock);
+    if (slot_codec_write(filename, buffer, BUF_SIZE, SAMPLE_RATE) < 0) {
+        pthread_mutex_unlock(&slotFileLock);
+        printf("Unable to save %s\n", filename);
+        return -1;
+    }
+    // the cached copies of the old recording are now stale, including an overdub not saved yet
+    invalidateSlot(num);
+    pthread_mutex_unlock(&slotFileLock);
+    // check if we update smaple256
+    printf("update wave \n");
+
+    return 0;
+}
+
+int saveSlot(void *arg, int slot) {
+    // Writes the cached recording of a slot to N.slc, on the session saver's thread after an overdub.
+    // A .slc block's coded size depends on its samples (Rice coded residuals), so a block changed by the
+    // take no longer fits where it was and the file is encoded again, to a temporary file renamed over N.slc
+    (void)arg;
+    pthread_mutex_lock(&slotFileLock);
+    pthread_mutex_lock(&slotCacheLock);
+    SlotCache *cache = &slotCache[slot];
+    uint32_t len = cache->rawLen;
+    int32_t *copy = NULL;
+    if (len > 0 && (copy = (int32_t *)malloc(len * sizeof(int32_t))) != NULL) {
+        memcpy(copy, cache->raw, len * sizeof(int32_t));
+    }
+    pthread_mutex_unlock(&slotCacheLock);
+    if (len == 0) {
+        // re-recorded since, the new recording is already on the card
+        pthread_mutex_unlock(&slotFileLock);
+        return 0;
+    }
+    if (copy == NULL) {
+        pthread_mutex_unlock(&slotFileLock);
+        fprintf(stderr, "Unable to allocate enough memory\n");
+        return -1;
+    }
+
+    char filename[20], tmpname[24];
+    sprintf(filename, "%d.slc", slot);
+    sprintf(tmpname, "%s.tmp", filename);
+    int ret = slot_codec_write(tmpname, copy, len, SAMPLE_RATE);
+    if (ret == 0 && rename(tmpname, filename) < 0) {
+        perror(filename);
+        ret = -1;
+    }
+    pthread_mutex_unlock(&slotFileLock);
+    free(copy);
+    return ret;
+}
+
+long msSince(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+void queueOverdubPlayback(playback_t *pb, const overdub_t *od, const int32_t *songAudio, uint64_t *queued, uint64_t len) {
+    // Top up the playback ring with the count-in and the song, as far as the free periods go
+    int32_t *period;
+    while (*queued < len && (period = playback_acquire(pb)) != NULL) {
+        uint32_t n = len - *queued < pb->period_words ? (uint32_t)(len - *queued) : pb->period_words;
+        for (uint32_t i = 0; i < n; i++) {
+            period[i] = overdub_playback_sample(od, songAudio, *queued + i);
         }
+        playback_commit(pb, n);
+        *queued += n;
+    }
+}
+
+int overdubSound(int num, const composition_snapshot_t *current, Outputs *outputs) {
+    // Records over the sound in a slot while the song plays out through the DMA. Whatever is played
+    // during a step the slot sounds on is mixed into the slot at the same offset, in the cached
+    // recording itself. The render worker must be idle (render_worker_cancel_wait): the song is rendered
+    // here through its reader slot, and the slot cache is held for the whole take
+    // The take stays in the cache; the caller has it written out with saveSlot, off the control loop
+    const song_t *song = &current->song;
+    uint32_t stepLen = song_step_samples(song, SAMPLE_RATE);
+
+    // what is played along to
+    render_job_t job = {current->version};
+    uint32_t songLen = 0;
+    int32_t *songAudio = renderSong(NULL, &job, &songLen);
+    if (songAudio == NULL) {
+        return -1;
+    }
+
+    audio_i2s_t my_config;
+    if (audio_i2s_init(&my_config) < 0) {
+        printf("Error initializing audio_i2s\n");
+        free(songAudio);
+        return -1;
+    }
+    audio_i2s_fifo_reset(&my_config);
+    uint32_t packetLen = audio_i2s_set_packet_len(&my_config, RECORD_PACKET_LEN);
+    uint32_t blockSamples = packetLen / 2;
+
+    // playback periods last as long as capture blocks, both run off the same word clock
+    playback_t pb;
+    if (playback_init(&pb, &my_config.s2mm, PLAYBACK_BUFFER_PADDR, blockSamples, PLAYBACK_PERIODS, NULL) < 0) {
+        audio_i2s_release(&my_config);
+        free(songAudio);
+        return -1;
+    }
+
+    pthread_mutex_lock(&slotCacheLock);
+    SlotCache *cache = &slotCache[num];
+    overdub_t od;
+    // the sound as it was, put back if the take is abandoned. The file may not have caught up with the cache
+    int32_t *before = NULL;
+    int ret = -1;
+    if (getFittedSlot(num, stepLen) == NULL) {
+        printf("Slot %d has nothing recorded to overdub\n", num);
+    } else if ((before = (int32_t *)malloc(cache->rawLen * sizeof(int32_t))) == NULL) {
+        fprintf(stderr, "Unable to allocate enough memory\n");
+    } else if (overdub_init(&od, cache->raw, cache->rawLen, song, num, stepLen, SAMPLE_RATE * OVERDUB_COUNT_IN, blockSamples) < 0) {
+        printf("Slot %d does not play anywhere in the song\n", num);
+    } else {
+        memcpy(before, cache->raw, cache->rawLen * sizeof(int32_t));
+        ret = 0;
+    }
+    if (ret < 0) {
+        pthread_mutex_unlock(&slotCacheLock);
+        free(before);
+        playback_release(&pb);
+        audio_i2s_release(&my_config);
+        free(songAudio);
+        return -1;
+    }
 
-        // check it works
-        if (i % 100 == check) {
-            // if it works, the buffer number should not always be 0 or the same value
-            printf("buffer[%d] =%u\n", p, buffer[p]);
+    // only the DC blocker, the gate would swallow the click
+    int32_t block[RECORD_PACKET_LEN / 2];
+    capture_t cap;
+    capture_init(&cap, block, blockSamples, 0);
+    capture_set_dsp(&cap, CAPTURE_DSP_DC_BLOCK);
+    meter_t meter;
+    bool metering = meter_init(&meter, SAMPLE_RATE) == 0;
+    if (metering) {
+        capture_set_meter(&cap, &meter);
+    }
+
+    uint64_t playLen = overdub_playback_len(&od);
+    uint64_t queued = 0;
+    queueOverdubPlayback(&pb, &od, songAudio, &queued, playLen);
+
+    // captured sample counts are the clock; playback is serviced while each capture block comes in
+    // A halted channel or a stream that stops never goes idle, so the wait is bounded and either ends the take
+    bool failed = false;
+    while (!od.done && od.captured < playLen + blockSamples) {
+        axi_dma_s2mm_start(&my_config.s2mm, packetLen * sizeof(uint32_t));
+        struct timespec blockStart;
+        clock_gettime(CLOCK_MONOTONIC, &blockStart);
+        while (!dma_s2mm_idle(&my_config.s2mm) && !dma_s2mm_halted(&my_config.s2mm) && msSince(&blockStart) < DMA_BLOCK_TIMEOUT_MS) {
+            playback_service(&pb, queued < playLen);
+            queueOverdubPlayback(&pb, &od, songAudio, &queued, playLen);
+        }
+        if (!dma_s2mm_idle(&my_config.s2mm) || dma_s2mm_error(&my_config.s2mm)) {
+            failed = true;
+            break;
+        }
+        if (od.captured == 0) {
+            playback_service(&pb, queued < playLen);
+            overdub_set_origin(&od, pb.played, audio_i2s_fifo_level(&my_config) / 2);
         }
+        capture_rewind(&cap);
+        capture_block(&cap, (const uint32_t *)my_config.s2mm.v_dst_addr, dma_s2mm_length(&my_config.s2mm) / sizeof(uint32_t));
+        overdub_block(&od, block, cap.written);
+        const meter_levels_t *levels = metering ? meter_take(&meter) : NULL;
+        if (levels != NULL) {
+            publishMeter(outputs, levels);
+        }
+    }
+    if (metering) {
+        meter_destroy(&meter);
     }
 
-    // write the test.wav and save as a .wav file
-    char filename[20];
-    sprintf(filename, "%d.wav", num);
-    write_wav(filename, BUF_SIZE, buffer, SAMPLE_RATE);
-    // Ensuring proper resource cleanup
-    // releasing hardware components upon task completion
+    if (failed) {
+        printf("Overdub abandoned, the capture DMA %s\n", dma_s2mm_error(&my_config.s2mm) ? "halted with an error" : "stopped delivering blocks");
+        playback_release(&pb);
+        audio_i2s_release(&my_config);
+        // part of the take is already mixed into the cached recording, the fitted copies are still from before it
+        memcpy(cache->raw, before, cache->rawLen * sizeof(int32_t));
+        pthread_mutex_unlock(&slotCacheLock);
+        free(before);
+        overdub_release(&od);
+        free(songAudio);
+        return -1;
+    }
+
+    printf("Overdub: latency %d samples (%.1fms, %s), %u samples mixed, %u playback underruns, %u samples dropped\n",
+           od.latency, 1000.0 * od.latency / SAMPLE_RATE, od.latency_measured ? "measured" : "click not heard",
+           od.mixed, pb.underruns, audio_i2s_fifo_dropped(&my_config));
+    playback_release(&pb);
     audio_i2s_release(&my_config);
-    // check if we update smaple256
-    printf("update wave \n");
 
+    // the fitted copies were made from the sound before the take, the recording stays where it is
+    dropFittedSlot(num);
+    pthread_mutex_unlock(&slotCacheLock);
+
+    free(before);
+    overdub_release(&od);
+    free(songAudio);
     return 0;
 }
 
 
-bool sendString(int sock, const char *str) {
-    // Send a string to the arduino
-    if (send(sock, str, strlen(str), 0) < 0) {
-        puts("Send failed");
-        return false;
+int playSong(const composition_snapshot_t *current) {
+    // Plays the current composition out through the DMA to the DAC. Like overdubSound, the render
+    // worker must be idle since the song is rendered here through its reader slot
+    render_job_t job = {current->version};
+    uint32_t songLen = 0;
+    int32_t *songAudio = renderSong(NULL, &job, &songLen);
+    if (songAudio == NULL) {
+        return -1;
     }
-    return true;
+
+    // the DMA core is shared with capture, which is left stopped
+    audio_i2s_t my_config;
+    if (audio_i2s_init(&my_config) < 0) {
+        printf("Error initializing audio_i2s\n");
+        free(songAudio);
+        return -1;
+    }
+    playback_t pb;
+    if (playback_init(&pb, &my_config.s2mm, PLAYBACK_BUFFER_PADDR, PLAYBACK_PERIOD_WORDS, PLAYBACK_PERIODS, NULL) < 0) {
+        audio_i2s_release(&my_config);
+        free(songAudio);
+        return -1;
+    }
+
+    // keep the ring topped up until the DMA has sent the whole song. A period takes ~25ms,
+    // so one that has not finished after DMA_BLOCK_TIMEOUT_MS means the stream has stopped
+    uint32_t queued = 0;
+    uint32_t done = pb.done;
+    struct timespec periodStart;
+    clock_gettime(CLOCK_MONOTONIC, &periodStart);
+    bool stalled = false;
+    while (pb.played < songLen && pb.errors == 0) {
+        int32_t *period;
+        while (queued < songLen && (period = playback_acquire(&pb)) != NULL) {
+            uint32_t n = songLen - queued < pb.period_words ? songLen - queued : pb.period_words;
+            memcpy(period, songAudio + queued, n * sizeof(int32_t));
+            playback_commit(&pb, n);
+            queued += n;
+        }
+        playback_service(&pb, queued < songLen);
+        if (pb.done != done) {
+            done = pb.done;
+            clock_gettime(CLOCK_MONOTONIC, &periodStart);
+        } else if (msSince(&periodStart) >= DMA_BLOCK_TIMEOUT_MS) {
+            stalled = true;
+            break;
+        }
+    }
+
+    int ret = 0;
+    if (stalled || pb.errors > 0) {
+        printf("Playback abandoned, the DMA %s\n", pb.errors > 0 ? "halted with an error" : "stopped taking samples");
+        ret = -1;
+    } else {
+        printf("Played %.1fs, %u underruns\n", (double)songLen / SAMPLE_RATE, pb.underruns);
+    }
+    playback_release(&pb);
+    audio_i2s_release(&my_config);
+    free(songAudio);
+    return ret;
 }
 
-void sendCompositionToLEDs(int sock, bool composition[][8], int row) {
+
+void sendCompositionToLEDs(led_link_t *leds, const pattern_t *pattern, int row) {
     // Update the arduino LEDs based on the current composition, by sending a string in the form (xxxxxxxx) to the arduino, where each x represents the state of one of the 8 LEDs
-    char message[12];  // "(00000000)\n" + null terminator
+    // The controller only shows the selected row, so an update replaces any earlier one that has not gone out yet
+    char message[NUM_LEDS + 3];  // "(00000000)\n"
     message[0] = '(';
-    for (int i = 0; i < 8; i++) {
-        message[i + 1] = composition[row][i] ? '1' : '0';
+    for (int i = 0; i < NUM_LEDS; i++) {
+        message[i + 1] = pattern_get(pattern, row, i) ? '1' : '0';
     }
-    message[9] = ')';
-    message[10] = '\n';
-    message[11] = '\0';
+    message[NUM_LEDS + 1] = ')';
+    message[NUM_LEDS + 2] = '\n';
 
-    puts("Sending ");
-    puts(message);
-    sendString(sock, message);
+    led_link_send(leds, LED_LINK_KEY_LEDS, message, sizeof(message));
 }
 
-void amplify(){
-    // Simple amplification of the final wav file
+void amplify(const int32_t *data, uint32_t numSamples){
+    // Simple amplification of the final render
     WavFile old;
-    read_wav_file("output.wav", &old);
-
-    for (uint32_t i = 0; i < old.subchunk2Size / 4; i++) {
-        old.data[i] = old.data[i]*16;
+    init_wav_header(&old, numSamples);
+    old.data = (int32_t *)malloc(numSamples * sizeof(int32_t));
+    if (old.data == NULL) {
+        fprintf(stderr, "Unable to allocate enough memory\n");
+        return;
+    }
+    for (uint32_t i = 0; i < numSamples; i++) {
+        old.data[i] = data[i]*16;
     }
 
     write_wav_file("output_amplified.wav", &old);
+    free(old.data);
 }
 
-int main() {
-    printf("Entered main\n");
-
-    // This stores the current composition, 4 sounds * 8 time steps
-    bool composition[4][8] = {};
+void publishRender(const int32_t *data, uint32_t len) {
+    // Writes a finished render out, on the render worker so the SD card writes do not hold up the buttons
+    // keep the render losslessly compressed, only the amplified copy is written as a .wav
+    slot_codec_write("output.slc", data, len, SAMPLE_RATE);
 
-    // Which row / sound is currently selected
-    int row = 0;
+    // The microphone recording is usually very quite so we amplify the final file
+    amplify(data, len);
+}
 
-    int sock;
-    struct sockaddr_in server;
+void sendReadyLED(led_link_t *leds, bool ready) {
+    // The ready LED is lit while a render of the current composition is waiting to be published
+    const char *message = ready ? "{1}\n" : "{0}\n";
+    led_link_send(leds, LED_LINK_KEY_READY, message, strlen(message));
+}
 
-    // To hold data received from the arduino
-    char server_reply[2000];
+void renderDone(void *arg, uint64_t version, bool published) {
+    // Called from the control loop when the render worker finishes
+    Outputs *outputs = (Outputs *)arg;
+    if (published) {
+        printf("Render published\n");
+        if (outputs->server != NULL) {
+            state_server_transport(outputs->server, STATE_TRANSPORT_IDLE, outputs->row);
+        }
+    }
+    if (version == composition_peek(&composition)->version) {
+        sendReadyLED(outputs->leds, true);
+    }
+}
 
-    // Create socket
-    sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock == -1) {
-        printf("Could not create socket");
+int parseIndex(const char *s) {
+    // The number in a command such as [s12], s points just after the letter. Only digits followed by
+    // the closing bracket are accepted, anything else gives -1
+    int index = 0;
+    int digits = 0;
+    for (; *s >= '0' && *s <= '9'; s++) {
+        if (++digits > 3) {
+            return -1;
+        }
+        index = index * 10 + (*s - '0');
     }
+    return digits > 0 && strcmp(s, "]") == 0 ? index : -1;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-a controller address[:port]] [-l listen address[:port]] [-n] [-t tracks] [-s steps] [-d step seconds] [-c pattern chain e.g. 0,0,1,0]\n", prog);
+    fprintf(stderr, "  the last session is restored unless -n or any of the grid options are given\n");
+    fprintf(stderr, "  -l serves the state to extra controllers and monitors, port %d by default\n", STATE_SERVER_PORT);
+}
 
-    // Setting the timeout of recv to 100ms, so we can keep polling for new input from the arduino but also do other things if we haven't received anything
-    struct timeval tv;
-    tv.tv_sec = 0;  // Timeout in seconds
-    tv.tv_usec = 100000;  // Timeout in microseconds
+void saveSession(session_saver_t *saver, const composition_snapshot_t *current, int editPattern, int row) {
+    // Hand a copy of the current state to the background saver, it is written once the changes settle
+    session_t session;
+    session.song = current->song;
+    session.edit_pattern = editPattern;
+    session.row = row;
+    memcpy(session.gains, current->gains, sizeof(session.gains));
+    session_saver_mark(saver, &session);
+}
+
+int main(int argc, char **argv) {
+    printf("Entered main\n");
 
-    // Set up socket
-    if (setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv)) < 0) {
-            perror("setsockopt failed");
+    // Grid size and tempo, 4 sounds * 8 time steps of half a second unless told otherwise
+    int numTracks = 4;
+    int numSteps = NUM_LEDS;
+    float stepDuration = RECORD_DURATION;
+    const char *chain = NULL;
+    bool newSession = false;
+    char controllerAddr[64] = CONTROLLER_ADDR;
+    int controllerPort = CONTROLLER_PORT;
+    char listenAddr[64] = "";
+    int listenPort = STATE_SERVER_PORT;
+    int opt;
+    while ((opt = getopt(argc, argv, "a:l:nt:s:d:c:")) != -1) {
+        switch (opt) {
+            case 'a': {
+                // host or host:port, e.g. 127.0.0.1:8080 for a stand-in controller
+                snprintf(controllerAddr, sizeof(controllerAddr), "%s", optarg);
+                char *colon = strchr(controllerAddr, ':');
+                if (colon != NULL) {
+                    *colon = '\0';
+                    controllerPort = atoi(colon + 1);
+                }
+                break;
+            }
+            case 'l': {
+                snprintf(listenAddr, sizeof(listenAddr), "%s", optarg);
+                char *colon = strchr(listenAddr, ':');
+                if (colon != NULL) {
+                    *colon = '\0';
+                    listenPort = atoi(colon + 1);
+                }
+                break;
+            }
+            case 'n': newSession = true; break;
+            case 't': numTracks = atoi(optarg); newSession = true; break;
+            case 's': numSteps = atoi(optarg); newSession = true; break;
+            case 'd': stepDuration = atof(optarg); newSession = true; break;
+            case 'c': chain = optarg; newSession = true; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+
+    float gains[NUM_SLOTS];
+    for (int t = 0; t < NUM_SLOTS; t++) {
+        gains[t] = 1.0f;
     }
 
-    // This is the ip address chosen for the server in the arduino code
-    server.sin_addr.s_addr = inet_addr("192.168.1.177");
-    server.sin_family = AF_INET;
-    server.sin_port = htons(80); // Port 80 like the arduino server
+    // The composition to start from: the patterns and the order they are played in
+    song_t song;
+    // Which pattern is being edited and which row / sound is currently selected
+    int editPattern = 0;
+    int row = 0;
 
-    // Connect to remote server (the arduino)
-    if (connect(sock, (struct sockaddr *)&server, sizeof(server)) < 0) {
-        perror("connect failed. Error");
+    // Pick up where the last run left off
+    session_t session;
+    struct timespec loadStart, loadEnd;
+    clock_gettime(CLOCK_MONOTONIC, &loadStart);
+    bool restored = !newSession && session_load(SESSION_FILE, &session) == 0;
+    clock_gettime(CLOCK_MONOTONIC, &loadEnd);
+    if (restored) {
+        song = session.song;
+        editPattern = session.edit_pattern;
+        row = session.row;
+        memcpy(gains, session.gains, sizeof(gains));
+        printf("Restored %s in %.1fus\n", SESSION_FILE,
+               (loadEnd.tv_sec - loadStart.tv_sec) * 1e6 + (loadEnd.tv_nsec - loadStart.tv_nsec) / 1e3);
+    } else {
+        song_init(&song, numTracks, numSteps, stepDuration);
+        if (chain != NULL) {
+            // patterns are created as the chain refers to them
+            song.chain_len = 0;
+            const char *c = chain;
+            while (*c != '\0') {
+                char *end;
+                long index = strtol(c, &end, 10);
+                if (end == c) {
+                    c++;
+                    continue;
+                }
+                while (index >= song.num_patterns && song_add_pattern(&song) >= 0);
+                song_chain_append(&song, (int)index);
+                c = end;
+            }
+            if (song.chain_len == 0) {
+                song_chain_append(&song, 0);
+            }
+        }
+        editPattern = song.chain[0];
+    }
+    printf("%d tracks * %d steps of %.3fs, %d patterns, chain of %d\n",
+           song.num_tracks, song.num_steps, song.step_duration, song.num_patterns, song.chain_len);
+
+    if (composition_init(&composition, &song, gains) < 0) {
         return 1;
     }
+    renderReader = composition_register_reader(&composition);
+    // the control loop's view of the composition, looked up again after every change it publishes
+    const composition_snapshot_t *current = composition_peek(&composition);
+
+    // Saved in the background so the button loop never waits on the SD card
+    session_saver_t saver;
+    bool saving = session_saver_start(&saver, SESSION_FILE) == 0;
+    if (saving) {
+        session_saver_set_slot_writer(&saver, saveSlot, NULL);
+    }
+    if (saving && !restored) {
+        saveSession(&saver, current, editPattern, row);
+    }
 
-    printf("connected, now waiting\n");
+    // To hold data received from the arduino
+    char server_reply[2000];
+
+    // Connect to the arduino. The link never blocks: it connects in the background, reconnects
+    // if the controller goes away and sends the latest LED state once it is back
+    led_link_t leds;
+    led_link_init(&leds, controllerAddr, controllerPort);
+
+    // Other controllers and monitors connect to us, they get a snapshot and then every change
+    state_server_t server;
+    bool serving = listenAddr[0] != '\0' && state_server_start(&server, listenAddr, listenPort, &composition) == 0;
+    if (serving) {
+        state_server_select(&server, editPattern, row);
+    }
 
-    //sending all LEDs off as the intialy configuration of the arduino LEDs
-    sendCompositionToLEDs(sock, composition, row);
+    printf("now waiting\n");
+
+    // sending the restored composition (all LEDs off for a new session) as the initial state of the arduino LEDs
+    sendCompositionToLEDs(&leds, &current->song.patterns[editPattern], row);
+    sendReadyLED(&leds, false);
+
+    // Renders happen on a worker thread. While the grid is left alone the current composition is
+    // rendered speculatively, so [4] usually only has to write out a render that is already done
+    Outputs outputs = {&leds, serving ? &server : NULL, row};
+    render_worker_t renderer;
+    bool rendering = render_worker_start(&renderer, renderSong, publishRender, renderDone, &outputs) == 0;
+    uint64_t submittedVersion = 0;     // newest version handed to the renderer
+    uint64_t seenVersion = current->version;
+    struct timespec lastChange;
+    clock_gettime(CLOCK_MONOTONIC, &lastChange);
 
     // Sit in a loop receiving button presses and sending LED updates
     while (true) {
 
-        // Try to receive some data from the arduino
+        // Try to receive some data from the arduino or the other controllers
+        // waits at most POLL_INTERVAL_MS, so we can keep polling for new input but also do other things if we haven't received anything
         memset(server_reply, 0, sizeof(server_reply));
-        if (recv(sock, server_reply, 2000, 0) != -1){
+        struct pollfd pfds[2 + STATE_SERVER_MAX_CLIENTS];
+        int wait = led_link_pollfd(&leds, &pfds[0], POLL_INTERVAL_MS);
+        int numFds = 1;
+        if (serving) {
+            numFds += state_server_pollfds(&server, pfds + 1);
+            if (state_server_pending(&server)) {
+                wait = 0;
+            }
+        }
+        if (poll(pfds, numFds, wait) < 0 && errno != EINTR) {
+            perror("poll");
+        }
+        // the arduino goes first, a command from another controller waits for the next pass
+        if (led_link_service(&leds, pfds[0].revents, server_reply, sizeof(server_reply)) > 0){
             puts("Server reply :");
             puts(server_reply);
+        } else if (serving && state_server_service(&server, pfds + 1, numFds - 1, server_reply, sizeof(server_reply)) > 0) {
+            printf("Client command: %s\n", server_reply);
         }
 
         // Changing the row based on the row/sound buttons
         bool rowChanged = false;
-        if (strcmp(server_reply, "[0]") == 0){
-            row = 0;
-            rowChanged = true;
-        } else if (strcmp(server_reply, "[1]") == 0){
-            row = 1;
-            rowChanged = true;
-        } else if (strcmp(server_reply, "[2]") == 0){
-            row = 2;
-            rowChanged = true;
-        } else if (strcmp(server_reply, "[3]") == 0){
-            row = 3;
-            rowChanged = true;
+        if (server_reply[0] == '[' && server_reply[1] >= '0' && server_reply[1] <= '3' && server_reply[2] == ']'){
+            int index = server_reply[1] - '0';
+            if (index < current->song.num_tracks) {
+                row = index;
+                rowChanged = true;
+            }
+        }
+        // the arduino only has four row buttons, other controllers can pick any row as [rN]
+        if (server_reply[0] == '[' && server_reply[1] == 'r') {
+            int index = parseIndex(server_reply + 2);
+            if (index >= 0 && index < current->song.num_tracks) {
+                row = index;
+                rowChanged = true;
+            }
+        }
+
+        // Changing the pattern being edited, sent as [pN]; a new pattern is added when N is one past the last,
+        // and played once at the end of the song so it is heard straight away
+        bool songChanged = false;
+        if (server_reply[0] == '[' && server_reply[1] == 'p') {
+            int index = parseIndex(server_reply + 2);
+            if (index >= 0 && index == current->song.num_patterns) {
+                composition_snapshot_t *next = composition_write_begin(&composition);
+                if (next != NULL && song_add_pattern(&next->song) >= 0) {
+                    song_chain_append(&next->song, index);
+                    composition_publish(&composition, next);
+                    current = composition_peek(&composition);
+                    songChanged = true;
+                } else if (next != NULL) {
+                    composition_write_abort(&composition, next);
+                }
+            }
+            if (index >= 0 && index < current->song.num_patterns) {
+                editPattern = index;
+                rowChanged = true;
+            }
+        }
+
+        // Editing the chain: [cN] plays pattern N once more at the end of the song, [c-] drops the last entry
+        if (server_reply[0] == '[' && server_reply[1] == 'c') {
+            int index = parseIndex(server_reply + 2);
+            bool drop = strcmp(server_reply + 2, "-]") == 0;
+            if ((index >= 0 && index < current->song.num_patterns && current->song.chain_len < SONG_MAX_CHAIN)
+                    || (drop && current->song.chain_len > 1)) {
+                composition_snapshot_t *next = composition_write_begin(&composition);
+                if (next != NULL) {
+                    if (drop) {
+                        next->song.chain_len--;
+                    } else {
+                        song_chain_append(&next->song, index);
+                    }
+                    composition_publish(&composition, next);
+                    current = composition_peek(&composition);
+                    songChanged = true;
+                }
+            }
         }
 
         if (strcmp(server_reply, "[4]") == 0){
             // Bottom middle button
-            // Renders the final wav file
-            makeFinalWav(composition);
-
-            // The microphone recording is usually very quite so we amplify the final file
-            amplify();
+            // Renders the final wav file, publishing the speculative render if it is already done
+            if (serving) {
+                state_server_transport(&server, STATE_TRANSPORT_RENDERING, row);
+            }
+            render_job_t job = {current->version};
+            if (rendering) {
+                render_worker_publish(&renderer, &job);
+                submittedVersion = job.version;
+            } else {
+                uint32_t len;
+                int32_t *data = renderSong(NULL, &job, &len);
+                if (data != NULL) {
+                    publishRender(data, len);
+                    free(data);
+                }
+                if (serving) {
+                    state_server_transport(&server, STATE_TRANSPORT_IDLE, row);
+                }
+            }
         }
-        if (strcmp(server_reply, "[5]") == 0){
+        if (strcmp(server_reply, "[y]") == 0){
+            // [y] (from another controller) plays the song through the DAC
+            if (serving) {
+                state_server_transport(&server, STATE_TRANSPORT_PLAYING, row);
+            }
+            // the song is rendered here, through the renderer's reader
+            if (rendering) {
+                render_worker_cancel_wait(&renderer);
+                submittedVersion = 0;
+            }
+            playSong(current);
+            if (serving) {
+                state_server_transport(&server, STATE_TRANSPORT_IDLE, row);
+            }
+        }
+        if (strcmp(server_reply, "[5]") == 0 || strcmp(server_reply, "[o]") == 0){
             // Top middle button
             // Records a new sound into the selected sound slot
-            getSound(row);
+            // [o] (from another controller) overdubs it instead, playing the song while recording over the slot
+            bool overdub = server_reply[1] == 'o';
+            if (serving) {
+                state_server_transport(&server, STATE_TRANSPORT_RECORDING, row);
+            }
+            // the sound is about to change under the renderer, wait until it has let go of the slots and its reader
+            if (rendering) {
+                render_worker_cancel_wait(&renderer);
+                submittedVersion = 0;
+            }
+            if ((overdub ? overdubSound(row, current, &outputs) : getSound(row, &outputs)) == 0) {
+                // an overdub is only in the cache so far
+                if (overdub && saving) {
+                    session_saver_mark_slot(&saver, row);
+                } else if (overdub) {
+                    saveSlot(NULL, row);
+                }
+                // the song is the same but its sound is not, a new version makes the renders out of date
+                composition_snapshot_t *next = composition_write_begin(&composition);
+                if (next != NULL) {
+                    composition_publish(&composition, next);
+                    current = composition_peek(&composition);
+                }
+            }
+            // the timeline LEDs showed the input level while recording
+            sendCompositionToLEDs(&leds, &current->song.patterns[editPattern], row);
+            if (serving) {
+                state_server_transport(&server, STATE_TRANSPORT_IDLE, row);
+            }
         }
 
        // Modifying the composition in the selected row with the timeline buttons
         bool compositionChanged = false;
         // data from the arduino comes in the form [x] where x is the button number
-        if (server_reply[0] == '[' && server_reply[2] == ']') {
-            int index = server_reply[1] - '0';
-            if (index >= 6){
-                composition[row][index - 6] = !composition[row][index - 6];
+        int step = -1;
+        // any client can send commands now, so only the button numbers themselves are accepted: [6]..[9] and [10]..[13]
+        if (server_reply[0] == '[' && server_reply[1] >= '6' && server_reply[1] <= '9' && server_reply[2] == ']') {
+            step = server_reply[1] - '6';
+        } else if (server_reply[0] == '[' && server_reply[1] == '1' && server_reply[2] >= '0' && server_reply[2] <= '3' && server_reply[3] == ']') {
+            int index = 10 + (server_reply[2] - '0');
+            step = index - 6;
+        } else if (server_reply[0] == '[' && server_reply[1] == 's') {
+            // the arduino has eight timeline buttons, other controllers can toggle any step as [sN]
+            step = parseIndex(server_reply + 2);
+        }
+        if (step >= 0 && step < current->song.num_steps) {
+            composition_snapshot_t *next = composition_write_begin(&composition);
+            if (next != NULL) {
+                pattern_toggle(&next->song.patterns[editPattern], row, step);
+                composition_publish(&composition, next);
+                current = composition_peek(&composition);
                 compositionChanged = true;
             }
-        } else if (server_reply[0] == '[' && server_reply[3] == ']') {
-            int index = (server_reply[1] - '0') * 10 + (server_reply[2] - '0');  // Convert two digit chars to int
-            if (index >= 10 && index <= 13) {
-                composition[row][index - 6] = !composition[row][index - 6];
-                compositionChanged = true;
+        }
+
+        // any finished render is now out of date
+        if (current->version != seenVersion) {
+            seenVersion = current->version;
+            clock_gettime(CLOCK_MONOTONIC, &lastChange);
+            sendReadyLED(&leds, false);
+        }
+
+        // update arduino LEDs and the other controllers if something has changed
+        outputs.row = row;
+        if (serving && rowChanged) {
+            state_server_select(&server, editPattern, row);
+        }
+        if (serving && compositionChanged) {
+            state_server_cell(&server, editPattern, row, step);
+        }
+        if (serving && songChanged) {
+            // there is no delta for the chain or the pattern count, clients get the whole song again
+            state_server_snapshot(&server);
+        }
+        if (compositionChanged || rowChanged || songChanged){
+            sendCompositionToLEDs(&leds, &current->song.patterns[editPattern], row);
+            if (saving) {
+                saveSession(&saver, current, editPattern, row);
             }
         }
 
-        // update arduino LEDs if something has changed
-        if (compositionChanged || rowChanged){
-            sendCompositionToLEDs(sock, composition, row);
+        if (rendering) {
+            render_worker_poll(&renderer);
+
+            // pre-render once the grid has been idle for a while
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long idleMs = (now.tv_sec - lastChange.tv_sec) * 1000 + (now.tv_nsec - lastChange.tv_nsec) / 1000000;
+            if (submittedVersion != current->version && idleMs >= RENDER_IDLE_MS) {
+                render_job_t job = {current->version};
+                render_worker_submit(&renderer, &job);
+                submittedVersion = job.version;
+            }
         }
     }
 
-    close(sock);
+    if (rendering) {
+        render_worker_stop(&renderer);
+    }
+    if (saving) {
+        session_saver_stop(&saver);
+    }
+    if (serving) {
+        state_server_stop(&server);
+    }
+    led_link_close(&leds);
+    composition_destroy(&composition);
 
     return 0;
 }
@@ -0,0 +1,162 @@
+/** COMP3601 Design Project A
+ * File name: meter.c
+ * Description: Input level meter and spectrum. The per sample work is only a few operations
+ * 	(meter.h) plus the anti-alias filter once every METER_DECIMATION samples, the transform and
+ * 	the band sums run once per update.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "meter.h"
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+int meter_init(meter_t *meter, uint32_t sample_rate) {
+    memset(meter, 0, sizeof(meter_t));
+    meter->period = sample_rate / METER_RATE_HZ;
+    meter->plan = fft_plan_create(METER_FFT_LEN);
+    if (meter->plan == NULL) {
+        fprintf(stderr, "Unable to allocate enough memory\n");
+        return -1;
+    }
+
+    for (int i = 0; i < METER_FFT_LEN; i++) {
+        meter->window[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / METER_FFT_LEN);
+    }
+
+    // Windowed sinc low-pass (Blackman). The transition is about 5.5/METER_FIR_TAPS of the sample
+    // rate wide, the cutoff is placed so the stopband starts at the decimated Nyquist frequency.
+    // Above that it is at least 74dB down, so aliases stay below anything the bands can show.
+    // The top band (~3.8-5.1kHz at 41kHz) is in the transition, a tone there reads low by more the
+    // nearer it is to the band's top edge (~14dB at 4.5kHz).
+    float cutoff = 0.5f / METER_DECIMATION - 2.75f / METER_FIR_TAPS;   // -6dB point, cycles per sample
+    float sum = 0.0f;
+    for (int i = 0; i < METER_FIR_TAPS; i++) {
+        float m = i - (METER_FIR_TAPS - 1) / 2.0f;
+        float t = 2.0f * (float)M_PI * i / (METER_FIR_TAPS - 1);
+        float w = 0.42f - 0.5f * cosf(t) + 0.08f * cosf(2.0f * t);
+        float h = 2.0f * (float)M_PI * cutoff * m;
+        meter->fir[i] = w * (m == 0.0f ? 1.0f : sinf(h) / h);
+        sum += meter->fir[i];
+    }
+    for (int i = 0; i < METER_FIR_TAPS; i++) {
+        meter->fir[i] /= sum;       // unity gain in the passband
+    }
+
+    // Bands are spaced evenly in log frequency from bin 1 to Nyquist, at least one bin wide
+    int bins = METER_FFT_LEN / 2;
+    meter->band_edges[0] = 1;
+    for (int b = 1; b < METER_BANDS; b++) {
+        int edge = (int)lroundf(powf((float)bins, (float)b / METER_BANDS));
+        if (edge <= meter->band_edges[b - 1]) {
+            edge = meter->band_edges[b - 1] + 1;
+        }
+        meter->band_edges[b] = edge;
+    }
+    meter->band_edges[METER_BANDS] = bins;
+
+    meter->levels.peak_db = METER_FLOOR_DB;
+    meter->levels.rms_db = METER_FLOOR_DB;
+    for (int b = 0; b < METER_BANDS; b++) {
+        meter->levels.bands[b] = METER_FLOOR_DB;
+    }
+    return 0;
+}
+
+void meter_destroy(meter_t *meter) {
+    fft_plan_destroy(meter->plan);
+    meter->plan = NULL;
+}
+
+void meter_decimate(meter_t *meter) {
+    // The filter is symmetric so it does not matter that the history runs oldest first. Four
+    // partial sums keep the multiply-adds from waiting on each other.
+    const float *x = meter->fir_hist + meter->fir_pos;
+    float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < METER_FIR_TAPS; i += 4) {
+        acc[0] += x[i] * meter->fir[i];
+        acc[1] += x[i + 1] * meter->fir[i + 1];
+        acc[2] += x[i + 2] * meter->fir[i + 2];
+        acc[3] += x[i + 3] * meter->fir[i + 3];
+    }
+    meter->ring[meter->ring_pos] = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+    meter->ring_pos = (meter->ring_pos + 1) % METER_FFT_LEN;
+}
+
+static inline float to_db(double power) {
+    // power relative to full scale, 1 = 0dB
+    if (power <= 0.0) {
+        return METER_FLOOR_DB;
+    }
+    float db = (float)(10.0 * log10(power));
+    return db < METER_FLOOR_DB ? METER_FLOOR_DB : db;
+}
+
+static void spectrum(meter_t *meter) {
+    // window the ring oldest sample first
+    uint32_t pos = meter->ring_pos;
+    for (int i = 0; i < METER_FFT_LEN; i++) {
+        meter->re[i] = meter->ring[(pos + i) % METER_FFT_LEN] * meter->window[i];
+        meter->im[i] = 0.0f;
+    }
+    fft_execute(meter->plan, meter->re, meter->im, false);
+
+    // A sine of amplitude A peaks at A*N/4 through the Hann window and spreads 1.5 times that
+    // peak's power over the neighbouring bins, scale so the band holding it reads A^2
+    const float scale = 1.0f / (1.5f * (METER_FFT_LEN / 4.0f) * (METER_FFT_LEN / 4.0f));
+    for (int b = 0; b < METER_BANDS; b++) {
+        float power = 0.0f;
+        for (int k = meter->band_edges[b]; k < meter->band_edges[b + 1]; k++) {
+            power += meter->re[k] * meter->re[k] + meter->im[k] * meter->im[k];
+        }
+        meter->levels.bands[b] = to_db(power * scale);
+    }
+}
+
+bool meter_block(meter_t *meter) {
+    if (meter->count + meter->carry < meter->period) {
+        return false;
+    }
+    uint64_t start = now_ns();
+
+    double peak = meter->peak / 2147483648.0;
+    meter->levels.peak_db = to_db(peak * peak);
+    meter->levels.rms_db = to_db(meter->sum_sq / meter->count);
+    spectrum(meter);
+
+    // Updates can only happen at the end of a block. The overshoot is carried into the next period
+    // so they still come METER_RATE_HZ times a second on average.
+    meter->carry = meter->count + meter->carry - meter->period;
+    if (meter->carry >= meter->period) {
+        meter->carry = 0;
+    }
+    meter->peak = 0;
+    meter->sum_sq = 0.0;
+    meter->count = 0;
+    meter->ready = true;
+
+    uint64_t elapsed = now_ns() - start;
+    meter->updates++;
+    meter->total_ns += elapsed;
+    if (elapsed > meter->max_ns) {
+        meter->max_ns = elapsed;
+    }
+    return true;
+}
+
+void meter_print_stats(const meter_t *meter, uint32_t sample_rate) {
+    if (meter->updates == 0) {
+        return;
+    }
+    double avg_us = meter->total_ns / 1000.0 / meter->updates;
+    double period_us = 1e6 * meter->period / sample_rate;
+    printf("meter: %u updates, avg %.2fus max %.2fus per update (%.3f%% of the %.0fus update period)\n",
+           meter->updates, avg_us, meter->max_ns / 1000.0, 100.0 * avg_us / period_us, period_us);
+}
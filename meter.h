@@ -0,0 +1,109 @@
+/** COMP3601 Design Project A
+ * File name: meter.h
+ * Description: Input level meter and spectrum, fed by the capture pass one sample at a time.
+ * 	Peak and RMS are accumulated over every sample. The spectrum is taken from a decimated copy of
+ * 	the signal, so one short FFT covers the whole audible range the microphone is useful for.
+ * 	The signal is low-passed before it is decimated so nothing above the decimated Nyquist folds
+ * 	back into the spectrum; the price is that the top band sits partly in the filter's roll-off.
+ * 	A new set of levels is ready METER_RATE_HZ times a second, whatever the DMA block size.
+ */
+
+#ifndef METER_H
+#define METER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "fft.h"
+
+#define METER_RATE_HZ 20                // level updates per second
+#define METER_DECIMATION 4              // input samples per spectrum sample, ~5kHz bandwidth at 41kHz
+#define METER_FIR_TAPS 128              // anti-alias low-pass run before decimating
+#define METER_FFT_LEN 256               // spectrum samples per transform, ~40Hz bins at 41kHz
+#define METER_BANDS 16                  // log spaced bands reported
+#define METER_FLOOR_DB -120.0f          // reported for silence
+
+typedef struct {
+    float peak_db;                      // dBFS over the last update period
+    float rms_db;
+    float bands[METER_BANDS];           // dB, a full scale sine reads 0 in its band
+} meter_levels_t;
+
+typedef struct {
+    uint32_t period;                    // samples between updates
+    uint32_t count;                     // samples since the last update
+    uint32_t carry;                     // how far the last update came after its period ended
+
+    // level accumulators
+    uint32_t peak;
+    double sum_sq;
+
+    // Decimator. The newest METER_FIR_TAPS samples are kept twice over, so they always sit in
+    // order at fir_hist[fir_pos] whatever the write position.
+    float fir[METER_FIR_TAPS];
+    float fir_hist[2 * METER_FIR_TAPS];
+    uint32_t fir_pos;
+    int dec_fill;
+
+    // the newest METER_FFT_LEN decimated samples
+    float ring[METER_FFT_LEN];
+    uint32_t ring_pos;
+
+    fft_plan_t *plan;
+    float window[METER_FFT_LEN];        // Hann
+    float re[METER_FFT_LEN];
+    float im[METER_FFT_LEN];
+    int band_edges[METER_BANDS + 1];    // first bin of each band, the last entry is one past the end
+
+    meter_levels_t levels;
+    bool ready;                         // levels holds an update not yet taken
+
+    // cost of the analysis run at each update
+    uint32_t updates;
+    uint64_t total_ns;
+    uint64_t max_ns;
+} meter_t;
+
+// Set up for a signal at sample_rate. Returns 0 on success, -1 on allocation failure.
+int meter_init(meter_t *meter, uint32_t sample_rate);
+void meter_destroy(meter_t *meter);
+
+// Filter the history into the next spectrum sample, called by meter_sample
+void meter_decimate(meter_t *meter);
+
+// Add one sample, called for every sample in order
+static inline void meter_sample(meter_t *meter, int32_t s) {
+    uint32_t a = s < 0 ? -(uint32_t)s : (uint32_t)s;
+    if (a > meter->peak) {
+        meter->peak = a;
+    }
+    float x = s * (1.0f / 2147483648.0f);
+    meter->sum_sq += x * x;
+
+    meter->fir_hist[meter->fir_pos] = x;
+    meter->fir_hist[meter->fir_pos + METER_FIR_TAPS] = x;
+    meter->fir_pos = (meter->fir_pos + 1) % METER_FIR_TAPS;
+    if (++meter->dec_fill == METER_DECIMATION) {
+        meter_decimate(meter);
+        meter->dec_fill = 0;
+    }
+    meter->count++;
+}
+
+// Call after each block of samples. Once a period has gone by the levels are worked out and
+// ready is set. Returns true if that happened.
+bool meter_block(meter_t *meter);
+
+// The latest levels if there is an update not yet taken, NULL otherwise.
+static inline const meter_levels_t *meter_take(meter_t *meter) {
+    if (!meter->ready) {
+        return NULL;
+    }
+    meter->ready = false;
+    return &meter->levels;
+}
+
+// Print how long each update took against the time between updates.
+void meter_print_stats(const meter_t *meter, uint32_t sample_rate);
+
+#endif
@@ -0,0 +1,136 @@
+/** COMP3601 Design Project A
+ * File name: overdub.c
+ * Description: Overdub (punch-in) alignment against the playback timeline.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "overdub.h"
+#include "capture.h"
+
+int overdub_init(overdub_t *od, int32_t *dst, uint32_t dst_len, const song_t *song, int track,
+                 uint32_t step_len, uint32_t count_in, uint32_t block_samples) {
+    memset(od, 0, sizeof(overdub_t));
+    od->dst = dst;
+    od->dst_len = dst_len;
+    od->step_len = step_len;
+    od->num_steps = song->num_steps;
+    od->chain_len = song->chain_len;
+    od->count_in = count_in;
+    od->block_samples = block_samples;
+    od->gain = 1.0f;
+    od->searching = true;
+
+    uint64_t mask = song_step_mask(song);
+    uint64_t any = 0;
+    for (int c = 0; c < song->chain_len; c++) {
+        od->active[c] = song->patterns[song->chain[c]].tracks[track] & mask;
+        any |= od->active[c];
+    }
+    if (any == 0 || dst_len == 0 || step_len == 0) {
+        return -1;
+    }
+
+    od->taken = (uint8_t *)calloc((dst_len + 7) / 8, 1);
+    if (od->taken == NULL) {
+        fprintf(stderr, "Unable to allocate enough memory\n");
+        return -1;
+    }
+    return 0;
+}
+
+void overdub_release(overdub_t *od) {
+    free(od->taken);
+    od->taken = NULL;
+}
+
+static inline uint64_t loop_len(const overdub_t *od) {
+    return (uint64_t)od->step_len * od->num_steps * od->chain_len;
+}
+
+int32_t overdub_playback_sample(const overdub_t *od, const int32_t *song_audio, uint64_t t) {
+    // full scale int32 like the render, the transmitter sends the top bits
+    if (t < od->count_in) {
+        return t < OVERDUB_CLICK_LEN ? OVERDUB_CLICK_LEVEL : 0;
+    }
+    t -= od->count_in;
+    return t < loop_len(od) ? song_audio[t] : 0;
+}
+
+uint64_t overdub_playback_len(const overdub_t *od) {
+    // the click is only looked for during the count-in, so the latency is less than count_in
+    return 2 * (uint64_t)od->count_in + loop_len(od);
+}
+
+void overdub_set_origin(overdub_t *od, uint64_t played, uint32_t fifo_samples) {
+    // The first block's samples came out of the FIFO ahead of the fifo_samples still in it, and
+    // they were being played against what the DMA had just finished sending
+    od->origin = (int64_t)played - fifo_samples - od->block_samples;
+}
+
+static inline int32_t saturate(int64_t x) {
+    if (x > INT32_MAX) return INT32_MAX;
+    if (x < INT32_MIN) return INT32_MIN;
+    return (int32_t)x;
+}
+
+static void mix(overdub_t *od, uint32_t offset, int32_t sample) {
+    // The slot's sound is fitted to step_len when played, so offsets scale between the two lengths.
+    // Each slot sample takes new material once per take, the first time its step comes round.
+    uint32_t from = (uint32_t)((uint64_t)offset * od->dst_len / od->step_len);
+    uint32_t to = (uint32_t)((uint64_t)(offset + 1) * od->dst_len / od->step_len);
+    if (to == from) {
+        to = from + 1;
+    }
+    for (uint32_t d = from; d < to && d < od->dst_len; d++) {
+        if (od->taken[d / 8] & (1 << (d % 8))) {
+            continue;
+        }
+        od->taken[d / 8] |= 1 << (d % 8);
+        // back to the slot's PCM precision, the codec drops the low bits only when they are zero
+        od->dst[d] = capture_quantize(saturate((int64_t)od->dst[d] + (int64_t)(sample * od->gain)));
+        od->mixed++;
+    }
+}
+
+bool overdub_block(overdub_t *od, const int32_t *samples, uint32_t count) {
+    uint64_t len = loop_len(od);
+    uint32_t pattern_len = od->step_len * od->num_steps;
+
+    for (uint32_t i = 0; i < count && !od->done; i++) {
+        int64_t t = od->origin + (int64_t)(od->captured + i);
+        int32_t s = samples[i];
+
+        if (od->searching) {
+            // nothing is mixed during the count-in, it is only listened to for the click
+            if (t >= 0 && t < od->count_in && (s > OVERDUB_CLICK_THRESHOLD || s < -OVERDUB_CLICK_THRESHOLD)) {
+                od->latency = (int32_t)t;
+                od->latency_measured = true;
+                od->searching = false;
+            } else if (t >= od->count_in) {
+                od->latency = 0;
+                od->searching = false;
+            }
+            continue;
+        }
+
+        int64_t p = t - od->latency - od->count_in;
+        if (p < 0) {
+            continue;
+        }
+        if ((uint64_t)p >= len) {
+            od->done = true;
+            break;
+        }
+        uint32_t pos = (uint32_t)p;
+        uint32_t c = pos / pattern_len;
+        uint32_t step = (pos % pattern_len) / od->step_len;
+        if ((od->active[c] >> step) & 1) {
+            mix(od, pos % od->step_len, s);
+        }
+    }
+    od->captured += count;
+    return od->done;
+}
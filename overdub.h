@@ -0,0 +1,76 @@
+/** COMP3601 Design Project A
+ * File name: overdub.h
+ * Description: Overdub (punch-in) alignment. While the song plays out through the DMA, captured
+ * 	audio is placed on the playback timeline and mixed into a slot's sound at the offset within
+ * 	the step it was played on, in place.
+ *
+ * 	Capture and playback run off the same I2S word clock, so the number of DMA blocks received is
+ * 	an exact sample clock. Only the offset between the two timelines has to be found:
+ * 	- origin: the playback position of the first captured sample, estimated from how much the
+ * 	  DMA has played and how much is still in the capture FIFO when the first block arrives.
+ * 	  Good to within one DMA block.
+ * 	- latency: the round trip through the DAC, speaker, air and microphone. The playback starts
+ * 	  with a count-in whose first sample is a click; where the click shows up in the capture
+ * 	  measures the whole path, including any error in origin.
+ * 	Material captured at timeline position t was played against song position
+ * 	t - latency - count_in. If the click is never heard (headphones), the latency is taken as 0
+ * 	and alignment falls back to the origin estimate.
+ */
+
+#ifndef OVERDUB_H
+#define OVERDUB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pattern.h"
+
+#define OVERDUB_CLICK_LEN 48                // samples of the count-in click, ~1ms at 41kHz
+#define OVERDUB_CLICK_LEVEL (1 << 29)       // quarter of full scale
+#define OVERDUB_CLICK_THRESHOLD (1 << 25)   // captured level that counts as the click coming back (~-36dBFS)
+
+typedef struct {
+    int32_t *dst;               // the slot's sound, mixed into in place
+    uint32_t dst_len;
+    uint8_t *taken;             // bit per dst sample, set once this take has mixed into it
+
+    // the song being played, one pass of it is the take
+    uint32_t step_len;          // samples per step
+    uint32_t num_steps;
+    uint32_t chain_len;
+    uint64_t active[SONG_MAX_CHAIN];    // steps the slot plays on, per chain position
+    uint32_t count_in;          // samples of count-in before the song, the click is at 0
+    float gain;                 // level the new material is mixed in at
+
+    // timebase
+    uint32_t block_samples;     // samples per DMA block
+    uint64_t captured;          // samples received, blocks * block_samples
+    int64_t origin;             // playback position of the first captured sample
+    int32_t latency;            // round trip in samples
+    bool searching;             // still listening for the click
+    bool latency_measured;      // the click was found, otherwise latency is 0
+
+    uint32_t mixed;             // slot samples that got new material
+    bool done;
+} overdub_t;
+
+// Prepare to overdub dst (dst_len samples, the slot's sound as recorded) for the given track of song.
+// Returns 0 on success, -1 if out of memory or the track is not played anywhere in the song.
+int overdub_init(overdub_t *od, int32_t *dst, uint32_t dst_len, const song_t *song, int track,
+                 uint32_t step_len, uint32_t count_in, uint32_t block_samples);
+void overdub_release(overdub_t *od);
+
+// The playback sample at position t of the take: the count-in click, then the rendered song.
+int32_t overdub_playback_sample(const overdub_t *od, const int32_t *song_audio, uint64_t t);
+
+// Samples of playback the take needs: count-in, one pass of the song and room for the latency.
+uint64_t overdub_playback_len(const overdub_t *od);
+
+// Call once, when the first block has arrived: played is how many samples the playback DMA had
+// finished at that moment and fifo_samples how many newer samples were still in the capture FIFO.
+void overdub_set_origin(overdub_t *od, uint64_t played, uint32_t fifo_samples);
+
+// Take in one converted DMA block. Returns true once the pass is complete.
+bool overdub_block(overdub_t *od, const int32_t *samples, uint32_t count);
+
+#endif
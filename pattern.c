@@ -0,0 +1,53 @@
+/** COMP3601 Design Project A
+ * File name: pattern.c
+ * Description: Pattern/song setup for the sequencer.
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "pattern.h"
+
+void song_init(song_t *song, int num_tracks, int num_steps, float step_duration) {
+    memset(song, 0, sizeof(song_t));
+
+    if (num_tracks < 1) num_tracks = 1;
+    if (num_tracks > PATTERN_MAX_TRACKS) num_tracks = PATTERN_MAX_TRACKS;
+    if (num_steps < 1) num_steps = 1;
+    if (num_steps > PATTERN_MAX_STEPS) num_steps = PATTERN_MAX_STEPS;
+    if (!(step_duration > 0.0f)) step_duration = 0.5f;
+
+    song->num_tracks = num_tracks;
+    song->num_steps = num_steps;
+    song->step_duration = step_duration;
+    song->num_patterns = 1;
+    song->chain_len = 1;
+    song->chain[0] = 0;
+}
+
+int song_add_pattern(song_t *song) {
+    if (song->num_patterns >= SONG_MAX_PATTERNS) {
+        return -1;
+    }
+    memset(&song->patterns[song->num_patterns], 0, sizeof(pattern_t));
+    return song->num_patterns++;
+}
+
+int song_chain_append(song_t *song, int pattern) {
+    if (pattern < 0 || pattern >= song->num_patterns || song->chain_len >= SONG_MAX_CHAIN) {
+        return -1;
+    }
+    song->chain[song->chain_len++] = (uint8_t)pattern;
+    return song->chain_len;
+}
+
+uint32_t song_step_samples(const song_t *song, uint32_t sample_rate) {
+    return (uint32_t)lrintf(sample_rate * song->step_duration);
+}
+
+uint64_t song_step_mask(const song_t *song) {
+    if (song->num_steps >= 64) {
+        return ~(uint64_t)0;
+    }
+    return ((uint64_t)1 << song->num_steps) - 1;
+}
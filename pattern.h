@@ -0,0 +1,72 @@
+/** COMP3601 Design Project A
+ * File name: pattern.h
+ * Description: Pattern/song data for the sequencer. Each track of a pattern is a bitset with one
+ * 	bit per step, and a song is a chain of patterns played one after another.
+ */
+
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PATTERN_MAX_TRACKS 16
+#define PATTERN_MAX_STEPS 64    // one uint64_t per track
+#define SONG_MAX_PATTERNS 16
+#define SONG_MAX_CHAIN 64
+
+typedef struct {
+    uint64_t tracks[PATTERN_MAX_TRACKS];    // bit s set = the track's sound plays on step s
+} pattern_t;
+
+typedef struct {
+    int num_tracks;
+    int num_steps;
+    float step_duration;                    // seconds per step
+    int num_patterns;
+    pattern_t patterns[SONG_MAX_PATTERNS];
+    int chain_len;
+    uint8_t chain[SONG_MAX_CHAIN];          // pattern indices in play order
+} song_t;
+
+// Sets up an empty song with one pattern chained once. Sizes are clamped to the maximums above.
+void song_init(song_t *song, int num_tracks, int num_steps, float step_duration);
+
+// Adds an empty pattern, returns its index or -1 if the song is full.
+int song_add_pattern(song_t *song);
+
+// Appends a pattern to the chain, returns the new chain length or -1 if it does not fit.
+int song_chain_append(song_t *song, int pattern);
+
+// Number of samples in one step at the given sample rate.
+uint32_t song_step_samples(const song_t *song, uint32_t sample_rate);
+
+// Bitmask of the steps that exist in this song.
+uint64_t song_step_mask(const song_t *song);
+
+static inline bool pattern_get(const pattern_t *pattern, int track, int step) {
+    return (pattern->tracks[track] >> step) & 1;
+}
+
+static inline void pattern_set(pattern_t *pattern, int track, int step, bool on) {
+    if (on) {
+        pattern->tracks[track] |= (uint64_t)1 << step;
+    } else {
+        pattern->tracks[track] &= ~((uint64_t)1 << step);
+    }
+}
+
+static inline void pattern_toggle(pattern_t *pattern, int track, int step) {
+    pattern->tracks[track] ^= (uint64_t)1 << step;
+}
+
+// Pops the lowest active step out of a copy of a track's bits, for walking only the active cells:
+//     uint64_t bits = pattern->tracks[t] & mask;
+//     while (bits) { int step = pattern_pop_step(&bits); ... }
+static inline int pattern_pop_step(uint64_t *bits) {
+    int step = __builtin_ctzll(*bits);
+    *bits &= *bits - 1;
+    return step;
+}
+
+#endif
@@ -0,0 +1,121 @@
+/** COMP3601 Design Project A
+ * File name: playback.c
+ * Description: MM2S buffer ring for audio output.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "axi_dma_mm2s.h"
+#include "playback.h"
+
+int playback_init(playback_t *pb, axi_dma_t *dma, uint32_t buf_paddr, uint32_t period_words, uint32_t periods, const char *uio) {
+    memset(pb, 0, sizeof(playback_t));
+    pb->irq_fd = -1;
+    if (period_words == 0 || period_words * sizeof(int32_t) > AXI_DMA_MAX_LENGTH ||
+        periods < 2 || periods > PLAYBACK_MAX_PERIODS || period_words * sizeof(int32_t) * periods > PLAYBACK_BUFFER_SIZE) {
+        fprintf(stderr, "Invalid playback ring of %u periods of %u samples\n", periods, period_words);
+        return -1;
+    }
+
+    pb->dma = dma;
+    pb->p_buf = buf_paddr;
+    pb->period_words = period_words;
+    pb->periods = periods;
+    pb->v_buf = (int32_t *)axi_dma_map(buf_paddr, period_words * sizeof(int32_t) * periods);
+    if (pb->v_buf == NULL) {
+        fprintf(stderr, "Unable to map the playback buffer\n");
+        return -1;
+    }
+    memset(pb->v_buf, 0, period_words * sizeof(int32_t) * periods);
+
+    if (uio != NULL) {
+        pb->irq_fd = axi_dma_irq_open(uio);
+        if (pb->irq_fd < 0) {
+            perror(uio);
+            axi_dma_unmap(pb->v_buf, period_words * sizeof(int32_t) * periods);
+            return -1;
+        }
+    }
+    dma_mm2s_ack_irq(dma);
+    return 0;
+}
+
+int32_t *playback_acquire(playback_t *pb) {
+    if (pb->committed - pb->done == pb->periods) {
+        return NULL;
+    }
+    return pb->v_buf + (pb->committed % pb->periods) * pb->period_words;
+}
+
+static void start_next(playback_t *pb) {
+    if (pb->busy || pb->sent == pb->committed) {
+        return;
+    }
+    uint32_t period = pb->sent % pb->periods;
+    uint32_t offset = period * pb->period_words * sizeof(int32_t);
+    axi_dma_mm2s_start(pb->dma, pb->p_buf + offset, pb->lens[period] * sizeof(int32_t));
+    pb->sent++;
+    pb->busy = true;
+}
+
+void playback_commit(playback_t *pb, uint32_t len) {
+    if (pb->committed - pb->done == pb->periods) {
+        return;
+    }
+    if (len > pb->period_words) {
+        len = pb->period_words;
+    }
+    pb->lens[pb->committed % pb->periods] = len;
+    pb->committed++;
+    start_next(pb);
+}
+
+void playback_pollfd(const playback_t *pb, struct pollfd *pfd) {
+    pfd->fd = pb->irq_fd;
+    pfd->events = POLLIN;
+    pfd->revents = 0;
+}
+
+int playback_service(playback_t *pb, bool more) {
+    if (pb->irq_fd >= 0) {
+        axi_dma_irq_ack(pb->irq_fd);
+    }
+
+    int finished = 0;
+    if (pb->busy) {
+        if (dma_mm2s_error(pb->dma)) {
+            // the period is lost, the next start resets the channel
+            pb->errors++;
+            finished = 1;
+        } else if (dma_mm2s_idle(pb->dma)) {
+            pb->played += pb->lens[pb->done % pb->periods];
+            finished = 1;
+        }
+    }
+    if (finished) {
+        dma_mm2s_ack_irq(pb->dma);
+        pb->done++;
+        pb->busy = false;
+    }
+
+    start_next(pb);
+    if (finished && !pb->busy && more) {
+        pb->underruns++;
+    }
+    return finished;
+}
+
+void playback_release(playback_t *pb) {
+    if (pb->v_buf == NULL) {
+        return;
+    }
+    if (pb->busy) {
+        dma_mm2s_stop(pb->dma);
+        pb->busy = false;
+    }
+    axi_dma_irq_close(pb->irq_fd);
+    pb->irq_fd = -1;
+    axi_dma_unmap(pb->v_buf, pb->period_words * sizeof(int32_t) * pb->periods);
+    pb->v_buf = NULL;
+}
@@ -0,0 +1,76 @@
+/** COMP3601 Design Project A
+ * File name: playback.h
+ * Description: Audio output through the MM2S DMA channel. The transmit buffer is a ring of
+ * 	periods in DMA memory. The producer (the mixer) writes samples straight into the next free
+ * 	period and commits it, the DMA streams committed periods to the I2S transmitter one transfer
+ * 	at a time and each completion interrupt starts the next one. Nothing is copied by the CPU.
+ * 	It shares the DMA core with capture, which keeps running on the S2MM channel.
+ * 	Samples are in the same format capture produces: int32 at full scale, of which the transmitter
+ * 	sends the top PCM_PRECISION (18) bits.
+ *
+ * 	Single threaded: acquire, commit and service must all be called from the same thread.
+ */
+
+#ifndef PLAYBACK_H
+#define PLAYBACK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <poll.h>
+
+#include "axi_dma.h"
+
+#define PLAYBACK_BUFFER_PADDR 0x70010000    // right after the receive buffer
+#define PLAYBACK_BUFFER_SIZE 0x10000
+#define PLAYBACK_PERIOD_WORDS 1024          // ~25 ms at 41 kHz, at most AXI_DMA_MAX_LENGTH bytes
+#define PLAYBACK_PERIODS 8
+#define PLAYBACK_MAX_PERIODS 16
+
+typedef struct {
+    axi_dma_t *dma;                     // the device capture uses, owned by the caller
+    uint32_t p_buf;
+    int32_t *v_buf;
+    uint32_t period_words;
+    uint32_t periods;
+
+    // free running counters, done <= sent <= committed <= done + periods
+    uint32_t lens[PLAYBACK_MAX_PERIODS];    // words committed in each period
+    uint32_t committed;
+    uint32_t sent;                      // handed to the DMA
+    uint32_t done;                      // finished by the DMA
+    bool busy;                          // a transfer is in flight
+    uint64_t played;                    // samples the DMA has finished sending
+
+    int irq_fd;                         // UIO interrupt, -1 to poll the status register
+
+    uint32_t underruns;                 // the DMA went idle while more audio was still expected
+    uint32_t errors;                    // transfers that halted the channel
+} playback_t;
+
+// Map the ring at buf_paddr and set up the MM2S channel of dma. uio is the DMA interrupt's UIO
+// device, or NULL to poll the status register. Returns 0 on success, -1 on error.
+int playback_init(playback_t *pb, axi_dma_t *dma, uint32_t buf_paddr, uint32_t period_words, uint32_t periods, const char *uio);
+
+// The next free period to write period_words samples into, NULL while the ring is full.
+int32_t *playback_acquire(playback_t *pb);
+
+// Queue the period from playback_acquire with its first len samples. Starts the DMA if it is idle.
+void playback_commit(playback_t *pb, uint32_t len);
+
+// Periods committed but not yet played
+static inline uint32_t playback_queued(const playback_t *pb) {
+    return pb->committed - pb->done;
+}
+
+// Fill in pfd for the interrupt (fd is -1 when polling the status register).
+void playback_pollfd(const playback_t *pb, struct pollfd *pfd);
+
+// Handle a completed transfer and start the next period. Call when the interrupt fd is readable,
+// or regularly when polling. more is false at the end of a stream so running dry is not an
+// underrun. Returns the number of periods finished.
+int playback_service(playback_t *pb, bool more);
+
+// Stop the channel and unmap the ring. Periods not yet played are dropped.
+void playback_release(playback_t *pb);
+
+#endif
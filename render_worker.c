@@ -0,0 +1,182 @@
+/** COMP3601 Design Project A
+ * File name: render_worker.c
+ * Description: Background render thread with cancellation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "render_worker.h"
+
+static void complete(render_worker_t *worker, uint64_t version, bool published) {
+    // called with the lock held
+    worker->completed = true;
+    worker->completed_version = version;
+    worker->completed_published = published;
+}
+
+static void *worker_main(void *arg) {
+    render_worker_t *worker = (render_worker_t *)arg;
+    render_job_t job;
+
+    pthread_mutex_lock(&worker->lock);
+    while (true) {
+        if (!worker->has_job && !worker->publish_wanted) {
+            worker->busy = false;
+            pthread_cond_broadcast(&worker->idle);
+        }
+        while (!worker->has_job && !worker->publish_wanted && !worker->stop) {
+            pthread_cond_wait(&worker->wake, &worker->lock);
+        }
+        if (worker->stop) {
+            break;
+        }
+        worker->busy = true;
+
+        if (worker->publish_wanted) {
+            // the kept render is current, just write it out
+            worker->publish_wanted = false;
+            uint64_t version = worker->data_version;
+            pthread_mutex_unlock(&worker->lock);
+            worker->publish(worker->data, worker->len);
+            pthread_mutex_lock(&worker->lock);
+            complete(worker, version, true);
+            continue;
+        }
+
+        job = worker->job;
+        worker->has_job = false;
+        worker->running = job.version;
+        pthread_mutex_unlock(&worker->lock);
+
+        uint32_t len = 0;
+        int32_t *data = worker->render(worker, &job, &len);
+
+        pthread_mutex_lock(&worker->lock);
+        worker->running = 0;
+        if (data == NULL) {
+            continue;
+        }
+        if (job.version != worker->latest) {
+            // finished just as a newer version came in
+            free(data);
+            continue;
+        }
+        free(worker->data);
+        worker->data = data;
+        worker->len = len;
+        worker->data_version = job.version;
+
+        bool publish = worker->publish_pending;
+        worker->publish_pending = false;
+        if (publish) {
+            pthread_mutex_unlock(&worker->lock);
+            worker->publish(data, len);
+            pthread_mutex_lock(&worker->lock);
+        }
+        complete(worker, job.version, publish);
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return NULL;
+}
+
+int render_worker_start(render_worker_t *worker, render_fn_t render, publish_fn_t publish, render_done_fn_t done, void *arg) {
+    memset(worker, 0, sizeof(render_worker_t));
+    worker->render = render;
+    worker->publish = publish;
+    worker->done = done;
+    worker->arg = arg;
+    pthread_mutex_init(&worker->lock, NULL);
+    pthread_cond_init(&worker->wake, NULL);
+    pthread_cond_init(&worker->idle, NULL);
+
+    if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+        fprintf(stderr, "Unable to start the render worker\n");
+        pthread_cond_destroy(&worker->idle);
+        pthread_cond_destroy(&worker->wake);
+        pthread_mutex_destroy(&worker->lock);
+        return -1;
+    }
+    return 0;
+}
+
+static void submit(render_worker_t *worker, const render_job_t *job) {
+    // called with the lock held, nothing to do if this version is already queued or rendering
+    if (worker->latest == job->version && (worker->has_job || worker->running == job->version)) {
+        return;
+    }
+    worker->job = *job;
+    worker->has_job = true;
+    __atomic_store_n(&worker->latest, job->version, __ATOMIC_RELEASE);
+    pthread_cond_signal(&worker->wake);
+}
+
+void render_worker_submit(render_worker_t *worker, const render_job_t *job) {
+    pthread_mutex_lock(&worker->lock);
+    submit(worker, job);
+    pthread_mutex_unlock(&worker->lock);
+}
+
+void render_worker_publish(render_worker_t *worker, const render_job_t *job) {
+    pthread_mutex_lock(&worker->lock);
+    if (worker->data != NULL && worker->data_version == job->version && __atomic_load_n(&worker->latest, __ATOMIC_RELAXED) == job->version) {
+        worker->publish_wanted = true;
+        pthread_cond_signal(&worker->wake);
+    } else {
+        worker->publish_pending = true;
+        submit(worker, job);
+    }
+    pthread_mutex_unlock(&worker->lock);
+}
+
+static void cancel(render_worker_t *worker) {
+    // called with the lock held
+    worker->has_job = false;
+    worker->publish_pending = false;
+    __atomic_store_n(&worker->latest, 0, __ATOMIC_RELEASE);
+}
+
+void render_worker_cancel(render_worker_t *worker) {
+    pthread_mutex_lock(&worker->lock);
+    cancel(worker);
+    pthread_mutex_unlock(&worker->lock);
+}
+
+void render_worker_cancel_wait(render_worker_t *worker) {
+    pthread_mutex_lock(&worker->lock);
+    cancel(worker);
+    // a render in flight sees the cancel at its next check, a publish of a finished render runs to the end
+    while (worker->busy || worker->publish_wanted) {
+        pthread_cond_wait(&worker->idle, &worker->lock);
+    }
+    pthread_mutex_unlock(&worker->lock);
+}
+
+void render_worker_poll(render_worker_t *worker) {
+    pthread_mutex_lock(&worker->lock);
+    bool completed = worker->completed;
+    uint64_t version = worker->completed_version;
+    bool published = worker->completed_published;
+    worker->completed = false;
+    pthread_mutex_unlock(&worker->lock);
+
+    if (completed) {
+        worker->done(worker->arg, version, published);
+    }
+}
+
+void render_worker_stop(render_worker_t *worker) {
+    pthread_mutex_lock(&worker->lock);
+    worker->stop = true;
+    __atomic_store_n(&worker->latest, 0, __ATOMIC_RELEASE);     // cancel whatever is rendering
+    pthread_cond_signal(&worker->wake);
+    pthread_mutex_unlock(&worker->lock);
+
+    pthread_join(worker->thread, NULL);
+    free(worker->data);
+    worker->data = NULL;
+    pthread_cond_destroy(&worker->idle);
+    pthread_cond_destroy(&worker->wake);
+    pthread_mutex_destroy(&worker->lock);
+}
@@ -0,0 +1,91 @@
+/** COMP3601 Design Project A
+ * File name: render_worker.h
+ * Description: Background thread for rendering the song, so the button loop never waits on a render.
+ * 	Each job names a version of the composition (see composition.h). Submitting a newer version makes
+ * 	an in-flight render give up, and the last finished render is kept so publishing it (writing the
+ * 	output files) does not need another render when nothing has changed since.
+ * 	Completions are reported through render_worker_poll on the caller's thread, so the callback can
+ * 	use things that are not thread safe (the controller link, the state server).
+ */
+
+#ifndef RENDER_WORKER_H
+#define RENDER_WORKER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#define RENDER_IDLE_MS 1500     // how long the grid must be left alone before a speculative render
+
+typedef struct {
+    uint64_t version;           // version of the composition to render, it increases with every change
+} render_job_t;
+
+typedef struct render_worker render_worker_t;
+
+// Renders a job, returning a malloc'd buffer of *len samples, or NULL if it failed or was cancelled.
+// Long renders should check render_worker_cancelled now and then.
+typedef int32_t *(*render_fn_t)(render_worker_t *worker, const render_job_t *job, uint32_t *len);
+// Writes a finished render out, runs on the worker thread.
+typedef void (*publish_fn_t)(const int32_t *data, uint32_t len);
+// Called from render_worker_poll when a render finishes or is published.
+typedef void (*render_done_fn_t)(void *arg, uint64_t version, bool published);
+
+struct render_worker {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t idle;        // broadcast whenever the worker goes back to waiting for work
+    render_fn_t render;
+    publish_fn_t publish;
+    render_done_fn_t done;
+    void *arg;
+
+    render_job_t job;           // next job to run
+    bool has_job;
+    bool stop;
+    bool busy;                  // rendering or publishing, false only while waiting for work
+    uint64_t latest;            // newest version submitted, read without the lock by render_worker_cancelled
+    uint64_t running;           // version being rendered, 0 when idle
+    bool publish_pending;       // publish the next render that finishes and is still current
+
+    // the last finished render, only touched by the worker thread once it is set
+    int32_t *data;
+    uint32_t len;
+    uint64_t data_version;
+    bool publish_wanted;        // publish data as it is, it is already current
+
+    // completion waiting for render_worker_poll
+    bool completed;
+    uint64_t completed_version;
+    bool completed_published;
+};
+
+int render_worker_start(render_worker_t *worker, render_fn_t render, publish_fn_t publish, render_done_fn_t done, void *arg);
+
+// Queue a render of job, replacing a queued one and cancelling one in flight if it is older.
+void render_worker_submit(render_worker_t *worker, const render_job_t *job);
+
+// Publish the render of job: straight away if it has already been rendered, otherwise once it has.
+// If the composition changes first, the render of the newer version is published instead.
+void render_worker_publish(render_worker_t *worker, const render_job_t *job);
+
+// Drop a queued job, a pending publish, and make a render in flight give up, e.g. before its sounds are replaced.
+// Returns straight away, the render may still be running for a moment.
+void render_worker_cancel(render_worker_t *worker);
+
+// Cancel as render_worker_cancel, then wait until the worker is idle. Afterwards nothing on the worker
+// touches the sounds or the composition until the next submit or publish.
+void render_worker_cancel_wait(render_worker_t *worker);
+
+// True when a newer version has been submitted and the render of job should stop.
+static inline bool render_worker_cancelled(render_worker_t *worker, const render_job_t *job) {
+    return __atomic_load_n(&worker->latest, __ATOMIC_ACQUIRE) != job->version;
+}
+
+// Run the done callback for a finished render, if there is one. Call from the control loop.
+void render_worker_poll(render_worker_t *worker);
+
+void render_worker_stop(render_worker_t *worker);
+
+#endif
@@ -0,0 +1,358 @@
+/** COMP3601 Design Project A
+ * File name: session.c
+ * Description: Session file encoding, atomic save and the debounced background saver.
+ *
+ * File layout (little endian):
+ * 	header   "C3SS", version (u32), payload size (u32), CRC-32 of the payload (u32)
+ * 	payload  tracks, steps, patterns, chain length (u8 each), step duration (f32),
+ * 	         edit pattern, row (u8 each), chain (u8 x chain length),
+ * 	         patterns (u64 per track, tracks x patterns),
+ * 	         per track: gain (f32)
+ * 	Version 1 files also stored each slot's length and sample rate (u32 each) after its gain. Nothing
+ * 	used them, they are skipped when an old file is loaded.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "session.h"
+
+#define SESSION_VERSION 2
+#define SESSION_HEADER_LEN 16
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_f32(uint8_t *p, float f) {
+    uint32_t v;
+    memcpy(&v, &f, 4);
+    put_u32(p, v);
+}
+
+static float get_f32(const uint8_t *p) {
+    uint32_t v = get_u32(p);
+    float f;
+    memcpy(&f, &v, 4);
+    return f;
+}
+
+static uint32_t crc32(const uint8_t *p, size_t len) {
+    // reflected CRC-32 (the zlib one), a nibble at a time so the table stays small
+    static const uint32_t table[16] = {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+    };
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= p[i];
+        crc = (crc >> 4) ^ table[crc & 15];
+        crc = (crc >> 4) ^ table[crc & 15];
+    }
+    return ~crc;
+}
+
+size_t session_encode(const session_t *session, uint8_t *buf) {
+    const song_t *song = &session->song;
+    uint8_t *p = buf + SESSION_HEADER_LEN;
+
+    *p++ = song->num_tracks;
+    *p++ = song->num_steps;
+    *p++ = song->num_patterns;
+    *p++ = song->chain_len;
+    put_f32(p, song->step_duration);
+    p += 4;
+    *p++ = session->edit_pattern;
+    *p++ = session->row;
+    memcpy(p, song->chain, song->chain_len);
+    p += song->chain_len;
+
+    for (int i = 0; i < song->num_patterns; i++) {
+        for (int t = 0; t < song->num_tracks; t++) {
+            uint64_t bits = song->patterns[i].tracks[t];
+            put_u32(p, (uint32_t)bits);
+            put_u32(p + 4, (uint32_t)(bits >> 32));
+            p += 8;
+        }
+    }
+
+    for (int t = 0; t < song->num_tracks; t++) {
+        put_f32(p, session->gains[t]);
+        p += 4;
+    }
+
+    uint32_t payload = p - buf - SESSION_HEADER_LEN;
+    memcpy(buf, "C3SS", 4);
+    put_u32(buf + 4, SESSION_VERSION);
+    put_u32(buf + 8, payload);
+    put_u32(buf + 12, crc32(buf + SESSION_HEADER_LEN, payload));
+    return p - buf;
+}
+
+int session_decode(const uint8_t *buf, size_t size, session_t *session) {
+    if (size < SESSION_HEADER_LEN || memcmp(buf, "C3SS", 4) != 0) {
+        return -1;
+    }
+    uint32_t version = get_u32(buf + 4);
+    if (version != 1 && version != SESSION_VERSION) {
+        return -1;
+    }
+    int track_len = version == 1 ? 12 : 4;
+    uint32_t payload = get_u32(buf + 8);
+    if (payload > size - SESSION_HEADER_LEN || crc32(buf + SESSION_HEADER_LEN, payload) != get_u32(buf + 12)) {
+        return -1;
+    }
+
+    const uint8_t *p = buf + SESSION_HEADER_LEN;
+    const uint8_t *end = p + payload;
+    if (end - p < 10) {
+        return -1;
+    }
+    int num_tracks = p[0];
+    int num_steps = p[1];
+    int num_patterns = p[2];
+    int chain_len = p[3];
+    float step_duration = get_f32(p + 4);
+    int edit_pattern = p[8];
+    int row = p[9];
+    p += 10;
+
+    if (num_tracks < 1 || num_tracks > PATTERN_MAX_TRACKS || num_steps < 1 || num_steps > PATTERN_MAX_STEPS
+            || num_patterns < 1 || num_patterns > SONG_MAX_PATTERNS || chain_len < 1 || chain_len > SONG_MAX_CHAIN
+            || !(step_duration > 0.0f) || edit_pattern >= num_patterns || row >= num_tracks
+            || end - p != chain_len + num_patterns * num_tracks * 8 + num_tracks * track_len) {
+        return -1;
+    }
+
+    memset(session, 0, sizeof(session_t));
+    song_t *song = &session->song;
+    song_init(song, num_tracks, num_steps, step_duration);
+    song->num_patterns = num_patterns;
+    song->chain_len = chain_len;
+    for (int i = 0; i < chain_len; i++) {
+        if (p[i] >= num_patterns) {
+            return -1;
+        }
+        song->chain[i] = p[i];
+    }
+    p += chain_len;
+
+    for (int i = 0; i < num_patterns; i++) {
+        for (int t = 0; t < num_tracks; t++) {
+            song->patterns[i].tracks[t] = get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+            p += 8;
+        }
+    }
+
+    for (int t = 0; t < PATTERN_MAX_TRACKS; t++) {
+        session->gains[t] = 1.0f;
+    }
+    for (int t = 0; t < num_tracks; t++) {
+        session->gains[t] = get_f32(p);
+        p += track_len;
+    }
+
+    session->edit_pattern = edit_pattern;
+    session->row = row;
+    return 0;
+}
+
+static int sync_dir(const char *path) {
+    // the rename is only durable once the directory holding the file is synced
+    char dir[256];
+    const char *slash = strrchr(path, '/');
+    if (slash == NULL) {
+        strcpy(dir, ".");
+    } else {
+        size_t len = slash - path;
+        if (len == 0) len = 1;
+        if (len >= sizeof(dir)) return -1;
+        memcpy(dir, path, len);
+        dir[len] = '\0';
+    }
+
+    int fd = open(dir, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    int ret = fsync(fd);
+    close(fd);
+    return ret;
+}
+
+int session_save(const char *path, const session_t *session) {
+    uint8_t buf[SESSION_MAX_SIZE];
+    size_t size = session_encode(session, buf);
+
+    char tmp[256];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+        return -1;
+    }
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("session: open");
+        return -1;
+    }
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = write(fd, buf + done, size - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("session: write");
+            close(fd);
+            unlink(tmp);
+            return -1;
+        }
+        done += n;
+    }
+    if (fsync(fd) < 0) {
+        perror("session: fsync");
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+    close(fd);
+
+    if (rename(tmp, path) < 0) {
+        perror("session: rename");
+        unlink(tmp);
+        return -1;
+    }
+    sync_dir(path);
+    return 0;
+}
+
+int session_load(const char *path, session_t *session) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    uint8_t buf[SESSION_MAX_SIZE];
+    ssize_t size = read(fd, buf, sizeof(buf));
+    close(fd);
+    if (size <= 0) {
+        return -1;
+    }
+    return session_decode(buf, size, session);
+}
+
+/*
+ * Background saver
+ */
+
+static void add_ms(struct timespec *ts, long ms) {
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+static void *saver_main(void *arg) {
+    session_saver_t *saver = (session_saver_t *)arg;
+    session_t copy;
+
+    pthread_mutex_lock(&saver->lock);
+    while (true) {
+        while (!saver->dirty && saver->dirty_slots == 0 && !saver->stop) {
+            pthread_cond_wait(&saver->changed, &saver->lock);
+        }
+        if (!saver->dirty && saver->dirty_slots == 0) {
+            break;
+        }
+        // wait out the debounce, each new change pushes the deadline back
+        if (!saver->stop && pthread_cond_timedwait(&saver->changed, &saver->lock, &saver->due) != ETIMEDOUT) {
+            continue;
+        }
+
+        bool dirty = saver->dirty;
+        uint32_t slots = saver->dirty_slots;
+        if (dirty) {
+            copy = saver->pending;
+        }
+        saver->dirty = false;
+        saver->dirty_slots = 0;
+        pthread_mutex_unlock(&saver->lock);
+        if (dirty) {
+            session_save(saver->path, &copy);
+        }
+        for (int slot = 0; slots != 0; slot++, slots >>= 1) {
+            if ((slots & 1) && saver->write_slot(saver->write_slot_arg, slot) < 0) {
+                fprintf(stderr, "Unable to save the sound in slot %d\n", slot);
+            }
+        }
+        pthread_mutex_lock(&saver->lock);
+    }
+    pthread_mutex_unlock(&saver->lock);
+    return NULL;
+}
+
+int session_saver_start(session_saver_t *saver, const char *path) {
+    memset(saver, 0, sizeof(session_saver_t));
+    saver->path = path;
+    pthread_mutex_init(&saver->lock, NULL);
+
+    // the deadline is measured on the monotonic clock so changing the time does not stall saving
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&saver->changed, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&saver->thread, NULL, saver_main, saver) != 0) {
+        fprintf(stderr, "Unable to start the session saver\n");
+        pthread_cond_destroy(&saver->changed);
+        pthread_mutex_destroy(&saver->lock);
+        return -1;
+    }
+    return 0;
+}
+
+void session_saver_mark(session_saver_t *saver, const session_t *session) {
+    pthread_mutex_lock(&saver->lock);
+    saver->pending = *session;
+    saver->dirty = true;
+    clock_gettime(CLOCK_MONOTONIC, &saver->due);
+    add_ms(&saver->due, SESSION_SAVE_DELAY_MS);
+    pthread_cond_signal(&saver->changed);
+    pthread_mutex_unlock(&saver->lock);
+}
+
+void session_saver_set_slot_writer(session_saver_t *saver, session_slot_writer_t write_slot, void *arg) {
+    pthread_mutex_lock(&saver->lock);
+    saver->write_slot = write_slot;
+    saver->write_slot_arg = arg;
+    pthread_mutex_unlock(&saver->lock);
+}
+
+void session_saver_mark_slot(session_saver_t *saver, int slot) {
+    pthread_mutex_lock(&saver->lock);
+    if (saver->write_slot != NULL && slot >= 0 && slot < 32) {
+        saver->dirty_slots |= 1u << slot;
+        clock_gettime(CLOCK_MONOTONIC, &saver->due);
+        add_ms(&saver->due, SESSION_SAVE_DELAY_MS);
+        pthread_cond_signal(&saver->changed);
+    }
+    pthread_mutex_unlock(&saver->lock);
+}
+
+void session_saver_stop(session_saver_t *saver) {
+    pthread_mutex_lock(&saver->lock);
+    saver->stop = true;
+    pthread_cond_signal(&saver->changed);
+    pthread_mutex_unlock(&saver->lock);
+
+    pthread_join(saver->thread, NULL);
+    pthread_cond_destroy(&saver->changed);
+    pthread_mutex_destroy(&saver->lock);
+}
@@ -0,0 +1,76 @@
+/** COMP3601 Design Project A
+ * File name: session.h
+ * Description: Session file, so the composition survives a crash or power cycle.
+ * 	Saves are debounced and written by a background thread to a temporary file that is
+ * 	fsync'd and renamed over the old one, so the file on disk is always a complete session.
+ * 	The same thread writes out recorded sounds changed in memory (overdubs), through a callback.
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "pattern.h"
+
+#define SESSION_FILE "session.bin"
+#define SESSION_SAVE_DELAY_MS 250   // changes closer together than this are saved once
+#define SESSION_MAX_SIZE 8192       // bigger than any encoded session
+
+typedef struct {
+    song_t song;
+    int edit_pattern;                       // pattern and row selected on the controller
+    int row;
+    float gains[PATTERN_MAX_TRACKS];        // mix gain per track
+} session_t;
+
+// Encode into buf (SESSION_MAX_SIZE bytes), returns the number of bytes used.
+size_t session_encode(const session_t *session, uint8_t *buf);
+
+// Decode and validate an encoded session. Returns 0 on success, -1 if it is corrupt.
+int session_decode(const uint8_t *buf, size_t size, session_t *session);
+
+// Write the session to path atomically. Returns 0 on success, -1 on error.
+int session_save(const char *path, const session_t *session);
+
+// Returns 0 on success, -1 if there is no valid session at path.
+int session_load(const char *path, session_t *session);
+
+// Writes out the sound in a slot, called on the saver's thread. Returns 0 on success, -1 on error.
+typedef int (*session_slot_writer_t)(void *arg, int slot);
+
+typedef struct {
+    const char *path;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    session_t pending;          // latest state handed to the saver
+    bool dirty;
+    uint32_t dirty_slots;       // bit per slot whose sound is waiting to be written
+    session_slot_writer_t write_slot;
+    void *write_slot_arg;
+    bool stop;
+    struct timespec due;        // when the pending state gets written
+} session_saver_t;
+
+// Start the background saver for path. Returns 0 on success, -1 on error.
+int session_saver_start(session_saver_t *saver, const char *path);
+
+// Queue a copy of the session to be saved once SESSION_SAVE_DELAY_MS pass without another change.
+// Only copies under a lock, so it is safe to call from the UI loop.
+void session_saver_mark(session_saver_t *saver, const session_t *session);
+
+// Set how slots marked with session_saver_mark_slot are written, before marking any.
+void session_saver_set_slot_writer(session_saver_t *saver, session_slot_writer_t write_slot, void *arg);
+
+// Queue the sound in slot (below 32) to be written with the next save, debounced the same way.
+void session_saver_mark_slot(session_saver_t *saver, int slot);
+
+// Write anything still pending and stop the thread.
+void session_saver_stop(session_saver_t *saver);
+
+#endif
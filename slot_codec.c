@@ -0,0 +1,409 @@
+/** COMP3601 Design Project A
+ * File name: slot_codec.c
+ * Description: Lossless .slc codec, fixed linear prediction with Rice coded residuals.
+ *
+ * Stream layout (little endian):
+ * 	header  "SLC1", sample rate (u32), number of samples (u32), block length (u32)
+ * 	blocks  bytes in the rest of the block (u32), predictor order (u8, 0xff = silent block),
+ * 	        wasted bits (u8), Rice parameter per partition (u8 x SLC_PARTITIONS),
+ * 	        warm-up samples (i32 x order), residual bitstream padded to a byte
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "slot_codec.h"
+
+#define SLC_HEADER_LEN 16
+#define SLC_BLOCK_HEADER_LEN (4 + 2 + SLC_PARTITIONS)
+#define SLC_SILENT_BLOCK 0xff
+#define SLC_MAX_ORDER 2
+#define RICE_ESCAPE 32              // quotients this long are written as an escape followed by the raw value
+#define RICE_RAW_BITS 40            // zigzagged residuals of an order 2 predictor on int32 fit in 36 bits
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t zigzag(int64_t r) {
+    return ((uint64_t)r << 1) ^ (uint64_t)(r >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t u) {
+    return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+}
+
+/*
+ * Bit writer, MSB first
+ */
+
+typedef struct {
+    uint8_t *p;
+    uint64_t acc;   // pending bits are the low n bits
+    int n;
+} bitwriter_t;
+
+static inline void put_bits(bitwriter_t *bw, uint64_t value, int bits) {
+    // bits <= 32
+    bw->acc = (bw->acc << bits) | (value & ((1ull << bits) - 1));
+    bw->n += bits;
+    while (bw->n >= 8) {
+        bw->n -= 8;
+        *bw->p++ = (uint8_t)(bw->acc >> bw->n);
+    }
+}
+
+static inline void put_rice(bitwriter_t *bw, uint64_t u, int k) {
+    uint64_t q = u >> k;
+    if (q >= RICE_ESCAPE) {
+        put_bits(bw, 0, RICE_ESCAPE);
+        put_bits(bw, 1, 1);
+        put_bits(bw, u >> 32, RICE_RAW_BITS - 32);
+        put_bits(bw, u, 32);
+        return;
+    }
+    // q zeros then a one, then the k low bits
+    put_bits(bw, 1, (int)q + 1);
+    if (k > 32) {
+        put_bits(bw, u >> 32, k - 32);
+        put_bits(bw, u, 32);
+    } else if (k > 0) {
+        put_bits(bw, u, k);
+    }
+}
+
+static void flush_bits(bitwriter_t *bw) {
+    if (bw->n > 0) {
+        *bw->p++ = (uint8_t)(bw->acc << (8 - bw->n));
+        bw->n = 0;
+    }
+}
+
+/*
+ * Bit reader, refilled a byte at a time into a 64 bit window so Rice codes decode with one clz
+ */
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint64_t buf;   // valid bits are the top n bits
+    int n;
+    int overrun;    // bytes read past the end
+} bitreader_t;
+
+static inline void refill(bitreader_t *br) {
+    while (br->n <= 56) {
+        uint64_t byte = 0;
+        if (br->p < br->end) {
+            byte = *br->p++;
+        } else {
+            br->overrun++;
+        }
+        br->buf |= byte << (56 - br->n);
+        br->n += 8;
+    }
+}
+
+static inline uint64_t get_bits(bitreader_t *br, int bits) {
+    // bits <= 32
+    if (bits == 0) {
+        return 0;
+    }
+    refill(br);
+    uint64_t v = br->buf >> (64 - bits);
+    br->buf <<= bits;
+    br->n -= bits;
+    return v;
+}
+
+static inline int get_rice(bitreader_t *br, int k, uint64_t *u) {
+    refill(br);
+    if (br->buf == 0) {
+        return -1;
+    }
+    int q = __builtin_clzll(br->buf);
+    if (q > RICE_ESCAPE) {
+        return -1;
+    }
+    br->buf <<= q + 1;
+    br->n -= q + 1;
+
+    if (q == RICE_ESCAPE) {
+        uint64_t hi = get_bits(br, RICE_RAW_BITS - 32);
+        *u = (hi << 32) | get_bits(br, 32);
+    } else if (k > 32) {
+        uint64_t hi = get_bits(br, k - 32);
+        *u = ((uint64_t)q << k) | (hi << 32) | get_bits(br, 32);
+    } else {
+        *u = ((uint64_t)q << k) | get_bits(br, k);
+    }
+    return 0;
+}
+
+/*
+ * Encoder
+ */
+
+size_t slot_codec_max_size(uint32_t num_samples) {
+    uint32_t blocks = (num_samples + SLC_BLOCK_LEN - 1) / SLC_BLOCK_LEN;
+    // worst case is an escaped code for every sample
+    return SLC_HEADER_LEN + (size_t)blocks * (SLC_BLOCK_HEADER_LEN + 4 * SLC_MAX_ORDER + 1)
+         + (size_t)num_samples * (RICE_ESCAPE + 1 + RICE_RAW_BITS + 7) / 8;
+}
+
+static inline int64_t residual(const int32_t *s, uint32_t i, int order, int shift) {
+    int64_t x0 = s[i] >> shift;
+    if (order == 0) return x0;
+    int64_t x1 = s[i - 1] >> shift;
+    if (order == 1) return x0 - x1;
+    int64_t x2 = s[i - 2] >> shift;
+    return x0 - 2 * x1 + x2;
+}
+
+static uint8_t *encode_block(const int32_t *s, uint32_t len, uint8_t *out) {
+    uint8_t *start = out;
+    out += 4;
+
+    uint32_t all = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        all |= (uint32_t)s[i];
+    }
+    if (all == 0) {
+        *out++ = SLC_SILENT_BLOCK;
+        put_u32(start, out - start - 4);
+        return out;
+    }
+    int shift = __builtin_ctz(all);
+
+    // pick the predictor with the smallest total residual
+    uint64_t cost[SLC_MAX_ORDER + 1] = {0};
+    for (uint32_t i = SLC_MAX_ORDER; i < len; i++) {
+        for (int order = 0; order <= SLC_MAX_ORDER; order++) {
+            int64_t r = residual(s, i, order, shift);
+            cost[order] += r < 0 ? -r : r;
+        }
+    }
+    int order = 0;
+    for (int o = 1; o <= SLC_MAX_ORDER; o++) {
+        if (cost[o] < cost[order]) {
+            order = o;
+        }
+    }
+    if ((uint32_t)order > len) {
+        order = len;
+    }
+
+    *out++ = (uint8_t)order;
+    *out++ = (uint8_t)shift;
+    uint8_t *params = out;
+    out += SLC_PARTITIONS;
+    for (int i = 0; i < order; i++) {
+        put_u32(out, (uint32_t)(s[i] >> shift));
+        out += 4;
+    }
+
+    // Rice parameter per partition from the mean of its zigzagged residuals
+    uint32_t part_len = (len + SLC_PARTITIONS - 1) / SLC_PARTITIONS;
+    bitwriter_t bw = {out, 0, 0};
+    for (int p = 0; p < SLC_PARTITIONS; p++) {
+        uint32_t from = p * part_len;
+        uint32_t to = from + part_len < len ? from + part_len : len;
+        if (from < (uint32_t)order) from = order;
+
+        uint64_t sum = 0;
+        for (uint32_t i = from; i < to; i++) {
+            sum += zigzag(residual(s, i, order, shift));
+        }
+        int k = 0;
+        uint64_t count = to > from ? to - from : 0;
+        while (k < RICE_RAW_BITS && (count << (k + 1)) < sum) {
+            k++;
+        }
+        params[p] = (uint8_t)k;
+
+        for (uint32_t i = from; i < to; i++) {
+            put_rice(&bw, zigzag(residual(s, i, order, shift)), k);
+        }
+    }
+    flush_bits(&bw);
+    out = bw.p;
+
+    put_u32(start, out - start - 4);
+    return out;
+}
+
+size_t slot_codec_encode(const int32_t *samples, uint32_t num_samples, uint32_t sample_rate, uint8_t *out) {
+    uint8_t *p = out;
+    memcpy(p, "SLC1", 4);
+    put_u32(p + 4, sample_rate);
+    put_u32(p + 8, num_samples);
+    put_u32(p + 12, SLC_BLOCK_LEN);
+    p += SLC_HEADER_LEN;
+
+    for (uint32_t i = 0; i < num_samples; i += SLC_BLOCK_LEN) {
+        uint32_t len = num_samples - i < SLC_BLOCK_LEN ? num_samples - i : SLC_BLOCK_LEN;
+        p = encode_block(samples + i, len, p);
+    }
+    return p - out;
+}
+
+/*
+ * Decoder
+ */
+
+int slot_codec_info(const uint8_t *in, size_t size, uint32_t *num_samples, uint32_t *sample_rate) {
+    if (size < SLC_HEADER_LEN || memcmp(in, "SLC1", 4) != 0 || get_u32(in + 12) != SLC_BLOCK_LEN) {
+        return -1;
+    }
+    *sample_rate = get_u32(in + 4);
+    *num_samples = get_u32(in + 8);
+    return 0;
+}
+
+static int decode_block(const uint8_t *in, size_t size, int32_t *s, uint32_t len) {
+    if (size < 1) {
+        return -1;
+    }
+    if (in[0] == SLC_SILENT_BLOCK) {
+        memset(s, 0, len * sizeof(int32_t));
+        return 0;
+    }
+
+    int order = in[0];
+    if (size < 2 + SLC_PARTITIONS + 4 * (size_t)order || order > SLC_MAX_ORDER || (uint32_t)order > len) {
+        return -1;
+    }
+    int shift = in[1];
+    if (shift > 31) {
+        return -1;
+    }
+    const uint8_t *params = in + 2;
+    const uint8_t *p = params + SLC_PARTITIONS;
+
+    int64_t x1 = 0, x2 = 0;    // previous two (shifted) samples
+    for (int i = 0; i < order; i++) {
+        x2 = x1;
+        x1 = (int32_t)get_u32(p);
+        s[i] = (int32_t)((uint32_t)x1 << shift);
+        p += 4;
+    }
+
+    uint32_t part_len = (len + SLC_PARTITIONS - 1) / SLC_PARTITIONS;
+    bitreader_t br = {p, in + size, 0, 0, 0};
+    for (int part = 0; part < SLC_PARTITIONS; part++) {
+        uint32_t from = part * part_len;
+        uint32_t to = from + part_len < len ? from + part_len : len;
+        if (from < (uint32_t)order) from = order;
+        int k = params[part];
+        if (k > RICE_RAW_BITS) {
+            return -1;
+        }
+
+        for (uint32_t i = from; i < to; i++) {
+            uint64_t u;
+            if (get_rice(&br, k, &u) < 0) {
+                return -1;
+            }
+            int64_t r = unzigzag(u);
+            int64_t x;
+            if (order == 0) x = r;
+            else if (order == 1) x = r + x1;
+            else x = r + 2 * x1 - x2;
+            x2 = x1;
+            x1 = x;
+            s[i] = (int32_t)((uint32_t)x << shift);
+        }
+    }
+
+    // the refill may read up to 8 bytes ahead, anything more means the block was truncated
+    return br.overrun * 8 > br.n ? -1 : 0;
+}
+
+int slot_codec_decode(const uint8_t *in, size_t size, int32_t *out) {
+    uint32_t num_samples, sample_rate;
+    if (slot_codec_info(in, size, &num_samples, &sample_rate) < 0) {
+        return -1;
+    }
+
+    const uint8_t *p = in + SLC_HEADER_LEN;
+    const uint8_t *end = in + size;
+    for (uint32_t i = 0; i < num_samples; i += SLC_BLOCK_LEN) {
+        if (end - p < 4) {
+            return -1;
+        }
+        uint32_t block_size = get_u32(p);
+        p += 4;
+        if ((size_t)(end - p) < block_size) {
+            return -1;
+        }
+        uint32_t len = num_samples - i < SLC_BLOCK_LEN ? num_samples - i : SLC_BLOCK_LEN;
+        if (decode_block(p, block_size, out + i, len) < 0) {
+            return -1;
+        }
+        p += block_size;
+    }
+    return 0;
+}
+
+/*
+ * Files
+ */
+
+int slot_codec_write(const char *filename, const int32_t *samples, uint32_t num_samples, uint32_t sample_rate) {
+    uint8_t *buf = (uint8_t *)malloc(slot_codec_max_size(num_samples));
+    if (buf == NULL) {
+        fprintf(stderr, "Unable to allocate enough memory\n");
+        return -1;
+    }
+    size_t size = slot_codec_encode(samples, num_samples, sample_rate, buf);
+
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "can not open the file\n");
+        free(buf);
+        return -1;
+    }
+    size_t written = fwrite(buf, 1, size, file);
+    fclose(file);
+    free(buf);
+    return written == size ? 0 : -1;
+}
+
+int32_t *slot_codec_read(const char *filename, uint32_t *num_samples, uint32_t *sample_rate) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    uint8_t *buf = (uint8_t *)malloc(size);
+    if (buf == NULL || fread(buf, 1, size, file) != (size_t)size) {
+        free(buf);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+
+    int32_t *samples = NULL;
+    if (slot_codec_info(buf, size, num_samples, sample_rate) == 0 && *num_samples > 0) {
+        samples = (int32_t *)malloc(*num_samples * sizeof(int32_t));
+        if (samples != NULL && slot_codec_decode(buf, size, samples) < 0) {
+            fprintf(stderr, "%s is corrupt\n", filename);
+            free(samples);
+            samples = NULL;
+        }
+    }
+    free(buf);
+    return samples;
+}
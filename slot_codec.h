@@ -0,0 +1,34 @@
+/** COMP3601 Design Project A
+ * File name: slot_codec.h
+ * Description: Lossless compressed format for recorded slots and renders (.slc files).
+ * 	Samples are coded in blocks with a fixed linear predictor and Rice coded residuals, the same
+ * 	idea as FLAC. Low bits that are zero across a whole block (the 14 unused bits of the 18 bit
+ * 	microphone samples) are not stored.
+ */
+
+#ifndef SLOT_CODEC_H
+#define SLOT_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SLC_BLOCK_LEN 4096          // samples per block
+#define SLC_PARTITIONS 16           // each block is split into partitions with their own Rice parameter
+
+// Upper bound on the encoded size of num_samples samples, for sizing the output buffer.
+size_t slot_codec_max_size(uint32_t num_samples);
+
+// Encode into out (at least slot_codec_max_size bytes). Returns the number of bytes used.
+size_t slot_codec_encode(const int32_t *samples, uint32_t num_samples, uint32_t sample_rate, uint8_t *out);
+
+// Read the header of an encoded buffer. Returns 0 on success, -1 if it is not a valid .slc stream.
+int slot_codec_info(const uint8_t *in, size_t size, uint32_t *num_samples, uint32_t *sample_rate);
+
+// Decode into out, which must hold num_samples samples (see slot_codec_info). Returns 0 on success, -1 on corrupt input.
+int slot_codec_decode(const uint8_t *in, size_t size, int32_t *out);
+
+// File helpers. slot_codec_read returns a malloc'd buffer (caller frees), or NULL on error.
+int slot_codec_write(const char *filename, const int32_t *samples, uint32_t num_samples, uint32_t sample_rate);
+int32_t *slot_codec_read(const char *filename, uint32_t *num_samples, uint32_t *sample_rate);
+
+#endif
@@ -0,0 +1,363 @@
+/** COMP3601 Design Project A
+ * File name: state_server.c
+ * Description: Non-blocking fan-out of the sequencer state to extra controllers and monitors.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "state_server.h"
+
+#define STATE_MSG_HEADER_LEN 3
+
+static void drop_client(state_client_t *client) {
+    close(client->fd);
+    client->fd = -1;
+}
+
+static uint8_t *reserve(state_server_t *server, state_client_t *client, int type, size_t len) {
+    // Space for one message at the end of a client's buffer, or NULL if the client is behind
+    if (client->resync) {
+        return NULL;
+    }
+    if (client->out_sent == client->out_len) {
+        client->out_len = 0;
+        client->out_sent = 0;
+    }
+    if (client->out_len + STATE_MSG_HEADER_LEN + len > STATE_CLIENT_BUF) {
+        // make room by dropping what has already gone out
+        memmove(client->out, client->out + client->out_sent, client->out_len - client->out_sent);
+        client->out_len -= client->out_sent;
+        client->out_sent = 0;
+        if (client->out_len + STATE_MSG_HEADER_LEN + len > STATE_CLIENT_BUF) {
+            client->resync = true;
+            server->resyncs++;
+            return NULL;
+        }
+    }
+    uint8_t *p = client->out + client->out_len;
+    p[0] = type;
+    p[1] = len;
+    p[2] = len >> 8;
+    client->out_len += STATE_MSG_HEADER_LEN + len;
+    return p + STATE_MSG_HEADER_LEN;
+}
+
+static void put_snapshot(state_server_t *server, state_client_t *client) {
+    const composition_snapshot_t *snap = composition_read_begin(server->comp, server->reader);
+    const song_t *song = &snap->song;
+    uint8_t *p = reserve(server, client, STATE_MSG_SNAPSHOT,
+                         12 + song->chain_len + (size_t)song->num_patterns * song->num_tracks * 8);
+    if (p == NULL) {
+        composition_read_end(server->comp, server->reader);
+        return;
+    }
+
+    uint32_t duration;
+    memcpy(&duration, &song->step_duration, 4);
+    *p++ = song->num_tracks;
+    *p++ = song->num_steps;
+    *p++ = song->num_patterns;
+    *p++ = song->chain_len;
+    for (int i = 0; i < 4; i++) {
+        *p++ = duration >> (8 * i);
+    }
+    *p++ = server->edit_pattern;
+    *p++ = server->row;
+    *p++ = server->transport;
+    *p++ = server->transport_slot;
+    memcpy(p, song->chain, song->chain_len);
+    p += song->chain_len;
+    for (int i = 0; i < song->num_patterns; i++) {
+        for (int t = 0; t < song->num_tracks; t++) {
+            uint64_t bits = song->patterns[i].tracks[t];
+            for (int b = 0; b < 8; b++) {
+                *p++ = bits >> (8 * b);
+            }
+        }
+    }
+    composition_read_end(server->comp, server->reader);
+}
+
+static void flush_client(state_server_t *server, state_client_t *client) {
+    while (client->fd >= 0) {
+        if (client->out_sent == client->out_len) {
+            client->out_len = 0;
+            client->out_sent = 0;
+            if (!client->resync) {
+                return;
+            }
+            // caught up after falling behind, start again from the current state
+            client->resync = false;
+            put_snapshot(server, client);
+        }
+        ssize_t n = send(client->fd, client->out + client->out_sent, client->out_len - client->out_sent,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                drop_client(client);
+            }
+            return;
+        }
+        client->out_sent += n;
+    }
+}
+
+static void broadcast(state_server_t *server, int type, const uint8_t *payload, size_t len) {
+    for (int i = 0; i < STATE_SERVER_MAX_CLIENTS; i++) {
+        state_client_t *client = &server->clients[i];
+        if (client->fd < 0) {
+            continue;
+        }
+        uint8_t *p = reserve(server, client, type, len);
+        if (p != NULL) {
+            memcpy(p, payload, len);
+        }
+        flush_client(server, client);
+    }
+}
+
+int state_server_start(state_server_t *server, const char *addr, uint16_t port, composition_t *comp) {
+    memset(server, 0, sizeof(state_server_t));
+    for (int i = 0; i < STATE_SERVER_MAX_CLIENTS; i++) {
+        server->clients[i].fd = -1;
+    }
+    server->comp = comp;
+    server->listen_fd = -1;
+    server->reader = composition_register_reader(comp);
+    if (server->reader < 0) {
+        fprintf(stderr, "No reader slot left for the state server\n");
+        return -1;
+    }
+
+    struct sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    if (inet_pton(AF_INET, addr, &local.sin_addr) != 1) {
+        fprintf(stderr, "Bad listen address %s\n", addr);
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0 || listen(fd, STATE_SERVER_MAX_CLIENTS) < 0) {
+        perror("state server");
+        close(fd);
+        return -1;
+    }
+    server->listen_fd = fd;
+    printf("Serving state on %s:%u\n", addr, port);
+    return 0;
+}
+
+int state_server_pollfds(const state_server_t *server, struct pollfd *pfds) {
+    int count = 0;
+    pfds[count].fd = server->listen_fd;
+    pfds[count].events = POLLIN;
+    pfds[count].revents = 0;
+    count++;
+    for (int i = 0; i < STATE_SERVER_MAX_CLIENTS; i++) {
+        const state_client_t *client = &server->clients[i];
+        if (client->fd < 0) {
+            continue;
+        }
+        pfds[count].fd = client->fd;
+        pfds[count].events = POLLIN | (client->out_sent < client->out_len || client->resync ? POLLOUT : 0);
+        pfds[count].revents = 0;
+        count++;
+    }
+    return count;
+}
+
+bool state_server_pending(const state_server_t *server) {
+    for (int i = 0; i < STATE_SERVER_MAX_CLIENTS; i++) {
+        if (server->clients[i].fd >= 0 && server->clients[i].has_cmd) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int state_server_attach(state_server_t *server, int fd) {
+    state_client_t *client = NULL;
+    for (int i = 0; i < STATE_SERVER_MAX_CLIENTS && client == NULL; i++) {
+        if (server->clients[i].fd < 0) {
+            client = &server->clients[i];
+        }
+    }
+    if (client == NULL) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    memset(client, 0, sizeof(state_client_t));
+    client->fd = fd;
+    put_snapshot(server, client);
+    flush_client(server, client);
+    return 0;
+}
+
+static void accept_clients(state_server_t *server) {
+    while (true) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            return;
+        }
+        state_server_attach(server, fd);
+    }
+}
+
+static void read_client(state_client_t *client) {
+    // Commands look like the arduino's, "[x]", anything outside the brackets is ignored.
+    // Reading stops once a command is waiting, so the socket stays readable until it is handed out
+    char data[64];
+    while (!client->has_cmd) {
+        ssize_t n = recv(client->fd, data, sizeof(data), MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            drop_client(client);
+            return;
+        }
+        if (n < 0) {
+            return;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            char c = data[i];
+            if (c == '[') {
+                client->in_len = 0;
+            }
+            if (client->in_len == 0 && c != '[') {
+                continue;
+            }
+            if (client->in_len < STATE_CLIENT_CMD_MAX - 1) {
+                client->in[client->in_len++] = c;
+            }
+            if (c == ']') {
+                // only the latest command is kept if a client sends several in one go
+                memcpy(client->cmd, client->in, client->in_len);
+                client->cmd[client->in_len] = '\0';
+                client->has_cmd = true;
+                client->in_len = 0;
+            }
+        }
+    }
+}
+
+int state_server_service(state_server_t *server, const struct pollfd *pfds, int count, char *buf, size_t size) {
+    if (size > 0) {
+        buf[0] = '\0';
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (pfds[i].revents == 0) {
+            continue;
+        }
+        if (pfds[i].fd == server->listen_fd) {
+            accept_clients(server);
+            continue;
+        }
+        for (int c = 0; c < STATE_SERVER_MAX_CLIENTS; c++) {
+            state_client_t *client = &server->clients[c];
+            if (client->fd != pfds[i].fd) {
+                continue;
+            }
+            if (pfds[i].revents & POLLIN) {
+                read_client(client);
+            } else if (pfds[i].revents & (POLLERR | POLLHUP)) {
+                drop_client(client);
+            }
+            if (client->fd >= 0 && (pfds[i].revents & POLLOUT)) {
+                flush_client(server, client);
+            }
+            break;
+        }
+    }
+
+    for (int c = 0; c < STATE_SERVER_MAX_CLIENTS; c++) {
+        state_client_t *client = &server->clients[c];
+        if (client->fd >= 0 && client->has_cmd) {
+            client->has_cmd = false;
+            snprintf(buf, size, "%s", client->cmd);
+            return strlen(buf);
+        }
+    }
+    return 0;
+}
+
+void state_server_cell(state_server_t *server, int pattern, int track, int step) {
+    const composition_snapshot_t *snap = composition_read_begin(server->comp, server->reader);
+    uint8_t msg[4] = {(uint8_t)pattern, (uint8_t)track, (uint8_t)step,
+                      (uint8_t)pattern_get(&snap->song.patterns[pattern], track, step)};
+    composition_read_end(server->comp, server->reader);
+    broadcast(server, STATE_MSG_CELL, msg, sizeof(msg));
+}
+
+void state_server_select(state_server_t *server, int pattern, int row) {
+    server->edit_pattern = pattern;
+    server->row = row;
+    uint8_t msg[2] = {(uint8_t)pattern, (uint8_t)row};
+    broadcast(server, STATE_MSG_SELECT, msg, sizeof(msg));
+}
+
+void state_server_transport(state_server_t *server, int transport, int slot) {
+    server->transport = transport;
+    server->transport_slot = slot;
+    uint8_t msg[2] = {(uint8_t)transport, (uint8_t)slot};
+    broadcast(server, STATE_MSG_TRANSPORT, msg, sizeof(msg));
+}
+
+static inline uint8_t db_below_full_scale(float db) {
+    float below = -db;
+    return below <= 0.0f ? 0 : below >= 255.0f ? 255 : (uint8_t)(below + 0.5f);
+}
+
+void state_server_meter(state_server_t *server, const meter_levels_t *levels) {
+    uint8_t msg[3 + METER_BANDS];
+    msg[0] = db_below_full_scale(levels->peak_db);
+    msg[1] = db_below_full_scale(levels->rms_db);
+    msg[2] = METER_BANDS;
+    for (int b = 0; b < METER_BANDS; b++) {
+        msg[3 + b] = db_below_full_scale(levels->bands[b]);
+    }
+    broadcast(server, STATE_MSG_METER, msg, sizeof(msg));
+}
+
+void state_server_snapshot(state_server_t *server) {
+    for (int i = 0; i < STATE_SERVER_MAX_CLIENTS; i++) {
+        state_client_t *client = &server->clients[i];
+        if (client->fd >= 0) {
+            put_snapshot(server, client);
+            flush_client(server, client);
+        }
+    }
+}
+
+void state_server_stop(state_server_t *server) {
+    for (int i = 0; i < STATE_SERVER_MAX_CLIENTS; i++) {
+        if (server->clients[i].fd >= 0) {
+            drop_client(&server->clients[i]);
+        }
+    }
+    if (server->listen_fd >= 0) {
+        close(server->listen_fd);
+        server->listen_fd = -1;
+    }
+}
@@ -0,0 +1,109 @@
+/** COMP3601 Design Project A
+ * File name: state_server.h
+ * Description: Server for extra controllers and monitoring clients (a second control surface,
+ * 	a visualiser on a laptop). Clients get a full snapshot when they connect and then compact
+ * 	binary deltas of the grid, the selected pattern/row and the transport. They may send the same
+ * 	"[x]" button commands as the arduino, "[y]" to play the song through the DAC and "[o]" to overdub
+ * 	the selected slot while the song plays.
+ * 	Rows and steps past the arduino's buttons are reached with "[rN]" (select row N) and "[sN]" (toggle
+ * 	step N of the selected row), the chain is edited with "[cN]" (append pattern N) and "[c-]".
+ * 	Every client has its own send buffer and nothing ever blocks: a client that cannot keep up
+ * 	stops getting deltas and is sent a fresh snapshot once it has drained its buffer.
+ *
+ * Messages: type (u8), payload length (u16, little endian), payload
+ * 	STATE_MSG_SNAPSHOT   tracks, steps, patterns, chain length (u8 each), step duration (f32),
+ * 	                     edit pattern, row, transport, transport slot (u8 each), chain (u8 x chain length),
+ * 	                     patterns (u64 per track, tracks x patterns, bit s = step s)
+ * 	STATE_MSG_CELL       pattern, track, step, on (u8 each)
+ * 	STATE_MSG_SELECT     pattern, row (u8 each)
+ * 	STATE_MSG_TRANSPORT  transport, slot (u8 each)
+ * 	STATE_MSG_METER      peak, rms (u8 each, dB below full scale), band count (u8), bands (u8 each, dB
+ * 	                     below full scale, lowest frequency first), METER_RATE_HZ times a second while recording
+ */
+
+#ifndef STATE_SERVER_H
+#define STATE_SERVER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <poll.h>
+
+#include "composition.h"
+#include "meter.h"
+
+#define STATE_SERVER_MAX_CLIENTS 8
+#define STATE_CLIENT_BUF 8192           // per client, several snapshots worth
+#define STATE_CLIENT_CMD_MAX 16         // longest command a client may send
+
+#define STATE_MSG_SNAPSHOT 1
+#define STATE_MSG_CELL 2
+#define STATE_MSG_SELECT 3
+#define STATE_MSG_TRANSPORT 4
+#define STATE_MSG_METER 5
+
+#define STATE_TRANSPORT_IDLE 0
+#define STATE_TRANSPORT_RECORDING 1
+#define STATE_TRANSPORT_RENDERING 2
+#define STATE_TRANSPORT_PLAYING 3
+
+typedef struct {
+    int fd;                             // -1 when the entry is free
+    uint8_t out[STATE_CLIENT_BUF];
+    size_t out_len;
+    size_t out_sent;
+    bool resync;                        // fell behind, send a snapshot once out is drained
+    char in[STATE_CLIENT_CMD_MAX];      // command being received
+    size_t in_len;
+    char cmd[STATE_CLIENT_CMD_MAX];     // last complete command, not yet handed out
+    bool has_cmd;
+} state_client_t;
+
+typedef struct {
+    int listen_fd;
+    state_client_t clients[STATE_SERVER_MAX_CLIENTS];
+
+    // what snapshots are built from, the composition is owned by the caller
+    composition_t *comp;
+    int reader;                         // reader slot in the composition
+    int edit_pattern;
+    int row;
+    int transport;
+    int transport_slot;
+
+    uint32_t resyncs;                   // times a slow client had its deltas replaced by a snapshot
+} state_server_t;
+
+// Listen on addr:port (addr "0.0.0.0" for every interface). Returns 0 on success, -1 on error.
+int state_server_start(state_server_t *server, const char *addr, uint16_t port, composition_t *comp);
+
+// Take a connected socket on as a client, as if it had just been accepted (it gets a snapshot
+// straight away). Returns 0 on success, -1 if every client entry is taken, in which case fd is closed.
+int state_server_attach(state_server_t *server, int fd);
+
+// Fill pfds with the descriptors to poll, returns how many (at most 1 + STATE_SERVER_MAX_CLIENTS).
+int state_server_pollfds(const state_server_t *server, struct pollfd *pfds);
+
+// True when a command was already received and the caller should not sleep in poll.
+bool state_server_pending(const state_server_t *server);
+
+// Handle the poll result for the descriptors from state_server_pollfds: accept clients, read
+// commands and write what the sockets take. The next client command is copied to buf
+// (NUL terminated) and its length returned, 0 if there is none.
+int state_server_service(state_server_t *server, const struct pollfd *pfds, int count, char *buf, size_t size);
+
+// Publish state changes to every client. The composition must already hold the new state.
+void state_server_cell(state_server_t *server, int pattern, int track, int step);
+void state_server_select(state_server_t *server, int pattern, int row);
+void state_server_transport(state_server_t *server, int transport, int slot);
+
+// Publish input levels to every client. Levels are not part of the snapshot, a client that falls
+// behind misses the updates sent before it is resynced.
+void state_server_meter(state_server_t *server, const meter_levels_t *levels);
+
+// Everything changed (patterns added, a session restored), send every client a snapshot.
+void state_server_snapshot(state_server_t *server);
+
+void state_server_stop(state_server_t *server);
+
+#endif
@@ -0,0 +1,145 @@
+/** COMP3601 Design Project A
+ * File name: composition_test.c
+ * Description: Copy-on-write composition under concurrent readers. A writer publishes as fast as
+ * 	it can, every snapshot holding its own version number in its patterns, while reader threads
+ * 	pin snapshots and look at them again after a while. A snapshot freed while pinned would be
+ * 	reused by the writer's next copy straight away and change under the reader. Readers also check
+ * 	versions never go backwards, and once they are gone nothing is left waiting to be freed.
+ * 	Worth running under a sanitizer too: make check CFLAGS="-O1 -g -fsanitize=thread" (or address).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "composition.h"
+
+#define READERS 4
+#define PUBLISHES 200000
+#define HOLD_SPINS 200          // reads of a pinned snapshot before letting go
+
+typedef struct {
+    composition_t *comp;
+    int slot;
+    bool *stop;
+    uint64_t reads;
+    uint64_t versions_seen;
+} reader_t;
+
+static bool consistent(const composition_snapshot_t *snap, uint64_t version) {
+    if (snap->version != version) {
+        return false;
+    }
+    for (int t = 0; t < snap->song.num_tracks; t++) {
+        if (snap->song.patterns[0].tracks[t] != version) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void *reader_main(void *arg) {
+    reader_t *reader = (reader_t *)arg;
+    uint64_t last = 0;
+    while (!__atomic_load_n(reader->stop, __ATOMIC_ACQUIRE)) {
+        const composition_snapshot_t *snap = composition_read_begin(reader->comp, reader->slot);
+        uint64_t version = snap->version;
+        assert(version >= last);
+        if (version != last) {
+            reader->versions_seen++;
+        }
+        last = version;
+        assert(consistent(snap, version));
+
+        // hold it while the writer carries on retiring and reclaiming
+        for (int i = 0; i < HOLD_SPINS; i++) {
+            assert(consistent(snap, version));
+            if (i % 64 == 0) {
+                sched_yield();
+            }
+        }
+        composition_read_end(reader->comp, reader->slot);
+        reader->reads++;
+    }
+    return NULL;
+}
+
+static int retired_count(const composition_t *comp) {
+    int count = 0;
+    for (const composition_snapshot_t *snap = comp->retired; snap != NULL; snap = snap->retired_next) {
+        count++;
+    }
+    return count;
+}
+
+static void publish(composition_t *comp) {
+    // every snapshot carries its version in its patterns so a reader can tell it is still the same one
+    composition_snapshot_t *next = composition_write_begin(comp);
+    assert(next != NULL);
+    uint64_t version = comp->current->version + 1;
+    for (int t = 0; t < next->song.num_tracks; t++) {
+        next->song.patterns[0].tracks[t] = version;
+    }
+    assert(composition_publish(comp, next) == version);
+}
+
+int main(void) {
+    song_t song;
+    song_init(&song, 8, 16, 0.5f);
+    for (int t = 0; t < song.num_tracks; t++) {
+        song.patterns[0].tracks[t] = 1;
+    }
+    composition_t comp;
+    assert(composition_init(&comp, &song, NULL) == 0);
+
+    bool stop = false;
+    pthread_t threads[READERS];
+    reader_t readers[READERS];
+    for (int r = 0; r < READERS; r++) {
+        readers[r].comp = &comp;
+        readers[r].slot = composition_register_reader(&comp);
+        readers[r].stop = &stop;
+        readers[r].reads = 0;
+        readers[r].versions_seen = 0;
+        assert(readers[r].slot >= 0);
+        assert(pthread_create(&threads[r], NULL, reader_main, &readers[r]) == 0);
+    }
+
+    int most_retired = 0;
+    for (int i = 0; i < PUBLISHES; i++) {
+        publish(&comp);
+        // the writer thread holds the write lock while publishing, so it may look at the list between
+        int retired = retired_count(&comp);
+        most_retired = retired > most_retired ? retired : most_retired;
+
+        // an aborted copy changes nothing
+        if (i % 1000 == 0) {
+            composition_snapshot_t *next = composition_write_begin(&comp);
+            assert(next != NULL);
+            next->song.num_tracks = 1;
+            composition_write_abort(&comp, next);
+        }
+    }
+
+    __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+    uint64_t reads = 0;
+    for (int r = 0; r < READERS; r++) {
+        pthread_join(threads[r], NULL);
+        reads += readers[r].reads;
+        assert(readers[r].reads > 0 && readers[r].versions_seen > 1);
+    }
+    assert(composition_peek(&comp)->version == 1 + PUBLISHES);
+    assert(composition_peek(&comp)->song.num_tracks == 8);
+
+    // with no reader left, the next publish frees everything retired
+    publish(&comp);
+    assert(comp.retired == NULL);
+
+    printf("composition_test: %d publishes, %llu reads, at most %d snapshots waiting to be freed\n",
+           PUBLISHES, (unsigned long long)reads, most_retired);
+    composition_destroy(&comp);
+    printf("composition_test: ok\n");
+    return 0;
+}
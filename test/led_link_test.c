@@ -0,0 +1,170 @@
+/** COMP3601 Design Project A
+ * File name: led_link_test.c
+ * Description: Controller link against a local listening socket standing in for the arduino:
+ * 	updates made while the controller is unreachable collapse to the latest one per key, the link
+ * 	reconnects with a growing backoff, and after a reconnect the latest state of every key is sent
+ * 	again, in the order the keys were last changed.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "led_link.h"
+
+#define TIMEOUT_MS 3000
+
+static long elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+static int bound_socket(uint16_t *port) {
+    // bound to an ephemeral port on loopback but not listening yet, so connecting is refused
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(fd >= 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    socklen_t len = sizeof(addr);
+    assert(getsockname(fd, (struct sockaddr *)&addr, &len) == 0);
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+// One pass of the caller's loop: poll the link, at most max_ms, and service it
+static int step(led_link_t *link, int max_ms, char *buf, size_t size) {
+    struct pollfd pfd;
+    int wait = led_link_pollfd(link, &pfd, max_ms);
+    if (pfd.fd >= 0) {
+        poll(&pfd, 1, wait);
+    } else if (wait > 0) {
+        poll(NULL, 0, wait);
+    }
+    return led_link_service(link, pfd.revents, buf, size);
+}
+
+// Run the link until the listener has a connection to accept, returns the accepted socket
+static int accept_link(int listen_fd, led_link_t *link) {
+    char buf[64];
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (elapsed_ms(&start) < TIMEOUT_MS) {
+        step(link, 10, buf, sizeof(buf));
+        struct pollfd pfd = {listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 0) == 1) {
+            int fd = accept(listen_fd, NULL, NULL);
+            assert(fd >= 0);
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            return fd;
+        }
+    }
+    assert(!"the link never connected");
+    return -1;
+}
+
+// Run the link and collect what the controller receives until it has len bytes
+static void expect(int fd, led_link_t *link, const char *want) {
+    char got[256];
+    size_t len = 0;
+    size_t want_len = strlen(want);
+    char buf[64];
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (len < want_len && elapsed_ms(&start) < TIMEOUT_MS) {
+        step(link, 10, buf, sizeof(buf));
+        ssize_t n = recv(fd, got + len, sizeof(got) - 1 - len, MSG_DONTWAIT);
+        if (n > 0) {
+            len += n;
+        }
+    }
+    got[len] = '\0';
+    if (strcmp(got, want) != 0) {
+        fprintf(stderr, "controller got \"%s\", expected \"%s\"\n", got, want);
+        assert(0);
+    }
+
+    // and nothing after it
+    for (int i = 0; i < 5; i++) {
+        step(link, 10, buf, sizeof(buf));
+    }
+    assert(recv(fd, got, sizeof(got), MSG_DONTWAIT) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+static void send_str(led_link_t *link, int key, const char *msg) {
+    led_link_send(link, key, msg, strlen(msg));
+}
+
+int main(void) {
+    uint16_t port;
+    int listen_fd = bound_socket(&port);
+
+    // nobody is listening yet, the first attempt is refused and every update collapses per key
+    led_link_t link;
+    led_link_init(&link, "127.0.0.1", port);
+    send_str(&link, LED_LINK_KEY_LEDS, "(10000000)\n");
+    send_str(&link, LED_LINK_KEY_READY, "{0}\n");
+    send_str(&link, LED_LINK_KEY_LEDS, "(11000000)\n");
+    send_str(&link, LED_LINK_KEY_LEDS, "(11100000)\n");
+    send_str(&link, LED_LINK_KEY_READY, "{1}\n");
+    assert(link.state != LED_LINK_UP);
+    assert(link.replaced == 3);
+
+    // once the controller is there it gets only the latest of each, oldest change first
+    assert(listen(listen_fd, 1) == 0);
+    int fd = accept_link(listen_fd, &link);
+    expect(fd, &link, "(11100000)\n{1}\n");
+    assert(link.state == LED_LINK_UP && link.reconnects == 0);
+
+    // button presses come back through the link
+    char buf[64];
+    assert(send(fd, "[4]", 3, 0) == 3);
+    int received = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (received == 0 && elapsed_ms(&start) < TIMEOUT_MS) {
+        received = step(&link, 10, buf, sizeof(buf));
+    }
+    assert(received == 3 && strcmp(buf, "[4]") == 0);
+
+    // the controller restarts: the link notices, reconnects and sends the latest state again,
+    // including the change made while it was gone, which is now the oldest
+    close(fd);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (link.state == LED_LINK_UP && elapsed_ms(&start) < TIMEOUT_MS) {
+        step(&link, 10, buf, sizeof(buf));
+    }
+    assert(link.state != LED_LINK_UP && link.reconnects == 1);
+    send_str(&link, LED_LINK_KEY_LEDS, "(00000001)\n");
+    fd = accept_link(listen_fd, &link);
+    expect(fd, &link, "(00000001)\n{1}\n");
+
+    // with the controller gone for good the retries back off, and never block the caller
+    close(fd);
+    close(listen_fd);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (elapsed_ms(&start) < 1000) {
+        struct timespec before;
+        clock_gettime(CLOCK_MONOTONIC, &before);
+        led_link_service(&link, 0, buf, sizeof(buf));
+        send_str(&link, LED_LINK_KEY_LEDS, "(00000010)\n");
+        assert(elapsed_ms(&before) < 50);
+        step(&link, 10, buf, sizeof(buf));
+    }
+    assert(link.state != LED_LINK_UP);
+    assert(link.backoff_ms >= 4 * LED_LINK_RETRY_MIN_MS && link.backoff_ms <= LED_LINK_RETRY_MAX_MS);
+
+    led_link_close(&link);
+    printf("led_link_test: ok\n");
+    return 0;
+}
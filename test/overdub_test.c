@@ -0,0 +1,104 @@
+/** COMP3601 Design Project A
+ * File name: overdub_test.c
+ * Description: Overdub alignment against a modelled capture: the take is played out, comes back
+ * 	through a round trip of a known latency with a player's material added, and has to land in
+ * 	the slot at the offset it was played on, whatever the error in the origin estimate.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "capture.h"
+#include "overdub.h"
+
+#define STEP_LEN 1000
+#define COUNT_IN 4000
+#define BLOCK 512
+#define FIFO 100
+#define MATERIAL_LEN 8000
+#define MAX_BLOCKS 1000
+
+static overdub_t od;
+static int32_t song_audio[MATERIAL_LEN];
+
+// What the DMA plays at position t of the take
+static int64_t played_at(int64_t t) {
+    if (t < 0 || (uint64_t)t >= overdub_playback_len(&od)) {
+        return 0;
+    }
+    return overdub_playback_sample(&od, song_audio, t);
+}
+
+// What the player adds, q samples after the song starts
+static int32_t material(int64_t q) {
+    return q < 0 || q >= MATERIAL_LEN ? 0 : (int32_t)((q + 1) * 16);
+}
+
+// One take. origin is where the first captured sample really sits on the playback timeline,
+// error is how far off the estimate from the DMA counters is and latency the round trip. With no
+// click only the material comes back, as with headphones. Returns the number of slot samples
+// that did not come out as expected.
+static int take(int64_t origin, int64_t error, uint32_t latency, bool click, uint32_t dst_len) {
+    song_t song;
+    song_init(&song, 2, 4, 0.5f);
+    song_add_pattern(&song);
+    song_chain_append(&song, 1);
+    pattern_set(&song.patterns[0], 1, 1, true);
+    pattern_set(&song.patterns[0], 1, 3, true);
+    pattern_set(&song.patterns[1], 1, 0, true);
+
+    int32_t *dst = (int32_t *)malloc(dst_len * sizeof(int32_t));
+    assert(dst != NULL);
+    for (uint32_t d = 0; d < dst_len; d++) {
+        dst[d] = 7;
+    }
+    assert(overdub_init(&od, dst, dst_len, &song, 1, STEP_LEN, COUNT_IN, BLOCK) == 0);
+
+    int32_t block[BLOCK];
+    uint64_t received = 0;
+    for (int b = 0; !od.done && b < MAX_BLOCKS; b++) {
+        for (uint32_t j = 0; j < BLOCK; j++) {
+            int64_t t = origin + received + j;
+            int64_t v = click ? played_at(t - latency) / 10 : 0;
+            block[j] = (int32_t)(v + material(t - latency - COUNT_IN));
+        }
+        if (b == 0) {
+            overdub_set_origin(&od, origin + BLOCK + FIFO + error, FIFO);
+        }
+        overdub_block(&od, block, BLOCK);
+        received += BLOCK;
+    }
+    assert(od.done);
+
+    // the track plays on the song's second step, slot sample d was played d/dst_len of a step in
+    int bad = 0;
+    for (uint32_t d = 0; d < dst_len; d++) {
+        uint32_t offset = (uint32_t)((uint64_t)d * STEP_LEN / dst_len);
+        if (dst[d] != capture_quantize(7 + material(STEP_LEN + offset))) {
+            bad++;
+        }
+    }
+    overdub_release(&od);
+    free(dst);
+    return bad;
+}
+
+int main(void) {
+    assert(take(300, 0, 700, true, 1000) == 0);
+    assert(take(300, -400, 700, true, 1000) == 0);     // origin off by most of a block, the click absorbs it
+    assert(take(-200, 250, 1500, true, 1000) == 0);
+    assert(take(300, 0, 0, false, 1000) == 0);         // no click, exact origin and no latency
+    assert(take(300, 200, 0, false, 1000) > 0);        // no click, misaligned by the origin error
+    assert(take(300, 0, 700, true, 2000) == 0);        // slot longer than a step
+    assert(take(300, 0, 700, true, 500) == 0);
+
+    // a track that is not played anywhere has nothing to overdub
+    song_t song;
+    song_init(&song, 2, 4, 0.5f);
+    int32_t x[10];
+    assert(overdub_init(&od, x, 10, &song, 0, STEP_LEN, 100, BLOCK) == -1);
+
+    printf("overdub_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,131 @@
+/** COMP3601 Design Project A
+ * File name: playback_test.c
+ * Description: Playback ring against the simulated DMA core (axi_dma_sim.h): periods are streamed
+ * 	in order straight from the producer's memory, capture can run alongside without resetting the
+ * 	core, and underruns and halted transfers are counted and recovered from.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+
+#include "axi_dma.h"
+#include "axi_dma_mm2s.h"
+#include "axi_dma_sim.h"
+#include "playback.h"
+
+#define MAX_PLAYED (8 * PLAYBACK_PERIOD_WORDS)
+#define CAPTURE_WORDS 256
+
+static int32_t played[MAX_PLAYED];
+static uint32_t num_played;
+static const void *transfers[16];
+static uint32_t num_transfers;
+
+static void sink(void *arg, void *data, uint32_t len) {
+    (void)arg;
+    if (num_transfers < 16) {
+        transfers[num_transfers] = data;
+    }
+    num_transfers++;
+    const int32_t *s = (const int32_t *)data;
+    for (uint32_t i = 0; i < len / 4 && num_played < MAX_PLAYED; i++) {
+        played[num_played++] = s[i];
+    }
+}
+
+static void source(void *arg, void *data, uint32_t len) {
+    (void)arg;
+    int32_t *s = (int32_t *)data;
+    for (uint32_t i = 0; i < len / 4; i++) {
+        s[i] = 1000 + i;
+    }
+}
+
+int main(void) {
+    axi_dma_t dma;
+    assert(axi_dma_init(&dma, AXI_DMA_S2MM_PADDR, AXI_DMA_RECV_BUFFER_PADDR, AXI_DMA_RECV_BUFFER_SIZE) == 0);
+    axi_dma_sim_set_mm2s_sink(dma.v_baseaddr, sink, NULL);
+    axi_dma_sim_set_s2mm_source(dma.v_baseaddr, source, NULL);
+
+    playback_t pb;
+    assert(playback_init(&pb, &dma, PLAYBACK_BUFFER_PADDR, PLAYBACK_PERIOD_WORDS, 4, NULL) == 0);
+    uint32_t resets = axi_dma_sim_resets(dma.v_baseaddr);
+
+    // fill the ring, the first period goes to the DMA straight away
+    int32_t *given[4];
+    int32_t *p;
+    int n = 0;
+    while ((p = playback_acquire(&pb)) != NULL) {
+        given[n] = p;
+        for (int i = 0; i < PLAYBACK_PERIOD_WORDS; i++) {
+            p[i] = n * PLAYBACK_PERIOD_WORDS + i;
+        }
+        playback_commit(&pb, PLAYBACK_PERIOD_WORDS);
+        n++;
+    }
+    assert(n == 4 && pb.sent == 1 && playback_queued(&pb) == 4);
+    assert(playback_service(&pb, true) == 0);
+
+    // capture while period 0 is in flight
+    axi_dma_sim_set_auto(dma.v_baseaddr, true);
+    axi_dma_s2mm_transfer(&dma, CAPTURE_WORDS * 4);
+    assert(((int32_t *)dma.v_dst_addr)[5] == 1005);
+    assert(dma_s2mm_length(&dma) == CAPTURE_WORDS * 4);
+    axi_dma_sim_set_auto(dma.v_baseaddr, false);
+    assert(axi_dma_sim_resets(dma.v_baseaddr) == resets);
+    assert(pb.busy);
+
+    // each completion starts the next period, a short one is queued as soon as there is room
+    for (int k = 0; k < 4; k++) {
+        assert(axi_dma_sim_step(dma.v_baseaddr) == 1);
+        assert(playback_service(&pb, k < 3) == 1);
+        if ((p = playback_acquire(&pb)) != NULL) {
+            for (int i = 0; i < 10; i++) {
+                p[i] = -(n * 10 + i);
+            }
+            playback_commit(&pb, 10);
+            n++;
+            break;
+        }
+    }
+    while (pb.busy) {
+        axi_dma_sim_step(dma.v_baseaddr);
+        playback_service(&pb, false);
+    }
+    assert(num_played == 4 * PLAYBACK_PERIOD_WORDS + 10);
+    for (int i = 0; i < 4 * PLAYBACK_PERIOD_WORDS; i++) {
+        assert(played[i] == i);
+    }
+    assert(played[4 * PLAYBACK_PERIOD_WORDS] == -40);
+
+    // the DMA read the producer's memory, nothing was copied
+    for (int i = 0; i < 4; i++) {
+        assert(transfers[i] == given[i]);
+    }
+    assert(transfers[4] == given[0]);
+    assert(pb.underruns == 0);
+
+    // a period finishing with nothing queued while more is expected is an underrun
+    p = playback_acquire(&pb);
+    playback_commit(&pb, 5);
+    axi_dma_sim_step(dma.v_baseaddr);
+    playback_service(&pb, true);
+    assert(pb.underruns == 1);
+
+    // a transfer from unmapped memory halts the channel, the ring recovers on the next commit
+    axi_dma_mm2s_start(&dma, 0x12345678, 64);
+    axi_dma_sim_step(dma.v_baseaddr);
+    assert(dma_mm2s_error(&dma) && dma_mm2s_halted(&dma));
+    dma_mm2s_status(&dma);
+    p = playback_acquire(&pb);
+    p[0] = 77;
+    playback_commit(&pb, 1);
+    axi_dma_sim_step(dma.v_baseaddr);
+    playback_service(&pb, false);
+    assert(played[num_played - 1] == 77 && pb.errors == 0);
+
+    playback_release(&pb);
+    axi_dma_release(&dma);
+    printf("playback_test: ok\n");
+    return 0;
+}
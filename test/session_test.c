@@ -0,0 +1,286 @@
+/** COMP3601 Design Project A
+ * File name: session_test.c
+ * Description: Session file encoding: a version 1 file still loads and saves again as version 2,
+ * 	saves go through the file system intact, slots marked for saving are each written once, and
+ * 	truncated files, files with a bad CRC and files whose fields are out of range are all rejected.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "session.h"
+
+#define HEADER_LEN 16
+#define PAYLOAD (HEADER_LEN)
+
+static uint32_t get_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static uint32_t crc32(const uint8_t *p, size_t len) {
+    // bit at a time, independent of the table in session.c
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= p[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (crc & 1 ? 0xedb88320 : 0);
+        }
+    }
+    return ~crc;
+}
+
+static void reseal(uint8_t *buf) {
+    // a valid CRC over whatever the payload now holds, so only the field checks can reject it
+    put_u32(buf + 12, crc32(buf + PAYLOAD, get_u32(buf + 8)));
+}
+
+static void make_session(session_t *session) {
+    memset(session, 0, sizeof(session_t));
+    song_init(&session->song, 5, 12, 0.25f);
+    song_add_pattern(&session->song);
+    song_add_pattern(&session->song);
+    song_chain_append(&session->song, 2);
+    song_chain_append(&session->song, 1);
+    pattern_set(&session->song.patterns[0], 0, 0, true);
+    pattern_set(&session->song.patterns[1], 4, 11, true);
+    pattern_set(&session->song.patterns[2], 2, 5, true);
+    session->song.patterns[2].tracks[3] = 0xfff;
+    session->edit_pattern = 2;
+    session->row = 4;
+    for (int t = 0; t < PATTERN_MAX_TRACKS; t++) {
+        session->gains[t] = 1.0f;
+    }
+    session->gains[1] = 0.5f;
+    session->gains[4] = 1.75f;
+}
+
+static void assert_same(const session_t *a, const session_t *b) {
+    const song_t *x = &a->song;
+    const song_t *y = &b->song;
+    assert(x->num_tracks == y->num_tracks && x->num_steps == y->num_steps);
+    assert(x->step_duration == y->step_duration);
+    assert(x->num_patterns == y->num_patterns && x->chain_len == y->chain_len);
+    assert(memcmp(x->chain, y->chain, x->chain_len) == 0);
+    for (int i = 0; i < x->num_patterns; i++) {
+        for (int t = 0; t < x->num_tracks; t++) {
+            assert(x->patterns[i].tracks[t] == y->patterns[i].tracks[t]);
+        }
+    }
+    assert(a->edit_pattern == b->edit_pattern && a->row == b->row);
+    for (int t = 0; t < PATTERN_MAX_TRACKS; t++) {
+        assert(a->gains[t] == b->gains[t]);
+    }
+}
+
+static size_t to_version_1(const uint8_t *v2, size_t size, uint8_t *v1) {
+    // Version 1 kept each slot's length and sample rate after its gain
+    int tracks = v2[PAYLOAD];
+    size_t gains = size - 4 * tracks;
+    memcpy(v1, v2, gains);
+    uint8_t *p = v1 + gains;
+    for (int t = 0; t < tracks; t++) {
+        memcpy(p, v2 + gains + 4 * t, 4);
+        put_u32(p + 4, 20500 + t);
+        put_u32(p + 8, 41000);
+        p += 12;
+    }
+    put_u32(v1 + 4, 1);
+    put_u32(v1 + 8, (uint32_t)(p - v1 - HEADER_LEN));
+    reseal(v1);
+    return p - v1;
+}
+
+static void test_round_trip(void) {
+    session_t session, decoded;
+    make_session(&session);
+    uint8_t buf[SESSION_MAX_SIZE];
+    size_t size = session_encode(&session, buf);
+    assert(get_u32(buf + 4) == 2);
+    assert(session_decode(buf, size, &decoded) == 0);
+    assert_same(&session, &decoded);
+
+    // an old file loads, and encodes again in the current version
+    uint8_t v1[SESSION_MAX_SIZE];
+    size_t v1_size = to_version_1(buf, size, v1);
+    assert(v1_size == size + 8 * (size_t)session.song.num_tracks);
+    assert(session_decode(v1, v1_size, &decoded) == 0);
+    assert_same(&session, &decoded);
+    uint8_t again[SESSION_MAX_SIZE];
+    assert(session_encode(&decoded, again) == size && memcmp(again, buf, size) == 0);
+}
+
+static void test_save_load(void) {
+    char dir[] = "/tmp/session_testXXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    char path[64];
+    snprintf(path, sizeof(path), "%s/%s", dir, SESSION_FILE);
+
+    session_t session, loaded;
+    make_session(&session);
+    assert(session_load(path, &loaded) == -1);
+    assert(session_save(path, &session) == 0);
+    assert(session_load(path, &loaded) == 0);
+    assert_same(&session, &loaded);
+
+    // the saver writes the latest of several changes once they settle, and anything pending on stop
+    session_saver_t saver;
+    assert(session_saver_start(&saver, path) == 0);
+    for (int i = 0; i < 10; i++) {
+        session.row = i % session.song.num_tracks;
+        session_saver_mark(&saver, &session);
+    }
+    session_saver_stop(&saver);
+    assert(session_load(path, &loaded) == 0);
+    assert_same(&session, &loaded);
+
+    unlink(path);
+    rmdir(dir);
+}
+
+static int slot_writes[PATTERN_MAX_TRACKS];
+
+static int count_slot_write(void *arg, int slot) {
+    (void)arg;
+    slot_writes[slot]++;
+    return 0;
+}
+
+static void test_slot_writes(void) {
+    char dir[] = "/tmp/session_testXXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    char path[64];
+    snprintf(path, sizeof(path), "%s/%s", dir, SESSION_FILE);
+
+    // slots marked several times before the saver gets to them are written once, with or without a session change
+    session_saver_t saver;
+    assert(session_saver_start(&saver, path) == 0);
+    session_saver_set_slot_writer(&saver, count_slot_write, NULL);
+    for (int i = 0; i < 10; i++) {
+        session_saver_mark_slot(&saver, 1);
+        session_saver_mark_slot(&saver, 3);
+    }
+    session_saver_stop(&saver);
+    assert(slot_writes[0] == 0 && slot_writes[1] == 1 && slot_writes[2] == 0 && slot_writes[3] == 1);
+    assert(access(path, F_OK) == -1);
+
+    unlink(path);
+    rmdir(dir);
+}
+
+static void test_truncated(void) {
+    session_t session, decoded;
+    make_session(&session);
+    uint8_t buf[SESSION_MAX_SIZE];
+    size_t size = session_encode(&session, buf);
+    for (size_t n = 0; n < size; n++) {
+        assert(session_decode(buf, n, &decoded) == -1);
+    }
+
+    // a header claiming more payload than there is
+    put_u32(buf + 8, get_u32(buf + 8) + 1);
+    assert(session_decode(buf, size, &decoded) == -1);
+}
+
+static void test_bad_crc(void) {
+    session_t session, decoded;
+    make_session(&session);
+    uint8_t buf[SESSION_MAX_SIZE];
+    size_t size = session_encode(&session, buf);
+    for (size_t i = 0; i < size; i++) {
+        if (i >= 4 && i < 12) {
+            continue;       // version and payload size, covered by the other tests
+        }
+        uint8_t copy[SESSION_MAX_SIZE];
+        memcpy(copy, buf, size);
+        copy[i] ^= 0x10;
+        assert(session_decode(copy, size, &decoded) == -1);
+    }
+}
+
+static void test_out_of_range(void) {
+    session_t session, decoded;
+    make_session(&session);
+    uint8_t buf[SESSION_MAX_SIZE];
+    size_t size = session_encode(&session, buf);
+
+    // offset into the payload, bad value
+    static const struct {
+        int offset;
+        uint8_t value;
+    } fields[] = {
+        {0, 0},                             // no tracks
+        {0, PATTERN_MAX_TRACKS + 1},
+        {1, 0},                             // no steps
+        {1, PATTERN_MAX_STEPS + 1},
+        {2, 0},                             // no patterns
+        {2, SONG_MAX_PATTERNS + 1},
+        {3, 0},                             // empty chain
+        {3, SONG_MAX_CHAIN + 1},
+        {8, 3},                             // editing a pattern that does not exist
+        {9, 5},                             // a row past the last track
+        {10, 3},                            // chaining a pattern that does not exist
+        {11, 200},
+    };
+    for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+        uint8_t copy[SESSION_MAX_SIZE];
+        memcpy(copy, buf, size);
+        copy[PAYLOAD + fields[f].offset] = fields[f].value;
+        reseal(copy);
+        assert(session_decode(copy, size, &decoded) == -1);
+    }
+
+    // step durations that are not a positive number
+    static const float durations[] = {0.0f, -0.5f, NAN};
+    for (size_t d = 0; d < sizeof(durations) / sizeof(durations[0]); d++) {
+        uint8_t copy[SESSION_MAX_SIZE];
+        memcpy(copy, buf, size);
+        uint32_t bits;
+        memcpy(&bits, &durations[d], 4);
+        put_u32(copy + PAYLOAD + 4, bits);
+        reseal(copy);
+        assert(session_decode(copy, size, &decoded) == -1);
+    }
+
+    // versions other than 1 and 2, and a different magic
+    uint8_t copy[SESSION_MAX_SIZE];
+    memcpy(copy, buf, size);
+    put_u32(copy + 4, 3);
+    assert(session_decode(copy, size, &decoded) == -1);
+    put_u32(copy + 4, 0);
+    assert(session_decode(copy, size, &decoded) == -1);
+    memcpy(copy, buf, size);
+    copy[0] = 'X';
+    assert(session_decode(copy, size, &decoded) == -1);
+
+    // sizes that do not match the counts, in either version
+    memcpy(copy, buf, size);
+    put_u32(copy + 4, 1);
+    assert(session_decode(copy, size, &decoded) == -1);
+    memcpy(copy, buf, size);
+    copy[size] = 0;
+    put_u32(copy + 8, get_u32(copy + 8) + 1);
+    reseal(copy);
+    assert(session_decode(copy, size + 1, &decoded) == -1);
+
+    // and the untouched file is still fine
+    assert(session_decode(buf, size, &decoded) == 0);
+}
+
+int main(void) {
+    test_round_trip();
+    test_save_load();
+    test_slot_writes();
+    test_truncated();
+    test_bad_crc();
+    test_out_of_range();
+    printf("session_test: ok\n");
+    return 0;
+}
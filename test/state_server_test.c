@@ -0,0 +1,176 @@
+/** COMP3601 Design Project A
+ * File name: state_server_test.c
+ * Description: State server fan-out over a socketpair. A client that stops reading has its deltas
+ * 	queued until its buffer is full, then nothing more is queued for it; once it reads again it
+ * 	gets the rest of what was queued, whole messages only, followed by a snapshot of the current
+ * 	state, and deltas resume. Commands are picked out of whatever the client sends.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "state_server.h"
+
+#define STREAM_MAX (1 << 20)
+#define MAX_CELLS 100000
+
+static uint8_t stream[STREAM_MAX];
+static size_t stream_len;
+
+// Everything the client end has been sent so far
+static void drain(int fd) {
+    while (stream_len < STREAM_MAX) {
+        ssize_t n = recv(fd, stream + stream_len, STREAM_MAX - stream_len, MSG_DONTWAIT);
+        if (n <= 0) {
+            assert(n == 0 || errno == EAGAIN || errno == EWOULDBLOCK);
+            return;
+        }
+        stream_len += n;
+    }
+}
+
+// One pass of the caller's loop, without waiting
+static int service(state_server_t *server, char *buf, size_t size) {
+    struct pollfd pfds[1 + STATE_SERVER_MAX_CLIENTS];
+    int count = state_server_pollfds(server, pfds);
+    poll(pfds, count, 0);
+    return state_server_service(server, pfds, count, buf, size);
+}
+
+typedef struct {
+    int type;
+    const uint8_t *payload;
+    size_t len;
+} message_t;
+
+// Split the stream into messages, every one must be whole and of a known type
+static int parse(message_t *messages, int max) {
+    int count = 0;
+    size_t pos = 0;
+    while (pos < stream_len) {
+        assert(stream_len - pos >= 3);
+        int type = stream[pos];
+        size_t len = stream[pos + 1] | (stream[pos + 2] << 8);
+        assert(type >= STATE_MSG_SNAPSHOT && type <= STATE_MSG_METER);
+        assert(stream_len - pos - 3 >= len);
+        assert(count < max);
+        messages[count].type = type;
+        messages[count].payload = stream + pos + 3;
+        messages[count].len = len;
+        count++;
+        pos += 3 + len;
+    }
+    return count;
+}
+
+static void toggle(composition_t *comp, state_server_t *server, int step) {
+    composition_snapshot_t *next = composition_write_begin(comp);
+    assert(next != NULL);
+    pattern_toggle(&next->song.patterns[0], 1, step);
+    composition_publish(comp, next);
+    state_server_cell(server, 0, 1, step);
+}
+
+static void check_snapshot(const message_t *msg, const song_t *song) {
+    assert(msg->type == STATE_MSG_SNAPSHOT);
+    assert(msg->len == 12 + (size_t)song->chain_len + (size_t)song->num_patterns * song->num_tracks * 8);
+    assert(msg->payload[0] == song->num_tracks && msg->payload[1] == song->num_steps);
+    const uint8_t *bits = msg->payload + 12 + song->chain_len;
+    for (int t = 0; t < song->num_tracks; t++) {
+        uint64_t v = 0;
+        for (int b = 0; b < 8; b++) {
+            v |= (uint64_t)bits[8 * t + b] << (8 * b);
+        }
+        assert(v == song->patterns[0].tracks[t]);
+    }
+}
+
+int main(void) {
+    song_t song;
+    song_init(&song, 4, 16, 0.5f);
+    composition_t comp;
+    assert(composition_init(&comp, &song, NULL) == 0);
+    state_server_t server;
+    assert(state_server_start(&server, "127.0.0.1", 0, &comp) == 0);
+
+    int sv[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    int size = 4096;
+    setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    assert(state_server_attach(&server, sv[0]) == 0);
+    state_client_t *client = &server.clients[0];
+
+    // a new client starts with a snapshot
+    drain(sv[1]);
+    message_t *messages = (message_t *)malloc(MAX_CELLS * sizeof(message_t));
+    assert(messages != NULL);
+    assert(parse(messages, MAX_CELLS) == 1);
+    check_snapshot(&messages[0], &composition_peek(&comp)->song);
+
+    // the client stops reading, deltas pile up until its buffer is full and then stop being queued
+    int sent = 0;
+    while (server.resyncs == 0 && sent < MAX_CELLS) {
+        toggle(&comp, &server, sent % 16);
+        sent++;
+    }
+    assert(server.resyncs == 1 && client->resync);
+    size_t queued = client->out_len;
+    for (int i = 0; i < 10; i++) {
+        toggle(&comp, &server, 3);
+        sent++;
+    }
+    assert(client->out_len == queued && server.resyncs == 1);
+
+    // reading again: the queued deltas, then a snapshot of the state as it is now
+    char cmd[STATE_CLIENT_CMD_MAX];
+    for (int i = 0; i < 1000 && (client->resync || client->out_sent < client->out_len); i++) {
+        drain(sv[1]);
+        assert(service(&server, cmd, sizeof(cmd)) == 0);
+    }
+    drain(sv[1]);
+    assert(!client->resync);
+    int count = parse(messages, MAX_CELLS);
+    int cells = 0;
+    for (int i = 1; i < count - 1; i++) {
+        assert(messages[i].type == STATE_MSG_CELL && messages[i].len == 4);
+        assert(messages[i].payload[2] == (cells % 16));     // in order, none skipped before the overflow
+        cells++;
+    }
+    assert(cells > 0 && cells < sent);
+    check_snapshot(&messages[count - 1], &composition_peek(&comp)->song);
+
+    // and deltas flow again
+    stream_len = 0;
+    toggle(&comp, &server, 7);
+    drain(sv[1]);
+    assert(parse(messages, MAX_CELLS) == 1 && messages[0].type == STATE_MSG_CELL && messages[0].payload[2] == 7);
+
+    // commands are picked out of the noise, only the latest of a burst is kept
+    const char *noise = "xx[12]yy[r3]z";
+    assert(send(sv[1], noise, strlen(noise), 0) == (ssize_t)strlen(noise));
+    int len = 0;
+    for (int i = 0; i < 100 && len == 0; i++) {
+        len = service(&server, cmd, sizeof(cmd));
+    }
+    assert(len == 4 && strcmp(cmd, "[r3]") == 0);
+    assert(!state_server_pending(&server));
+
+    // a client that goes away is dropped
+    close(sv[1]);
+    for (int i = 0; i < 100 && client->fd >= 0; i++) {
+        service(&server, cmd, sizeof(cmd));
+    }
+    assert(client->fd < 0);
+
+    free(messages);
+    state_server_stop(&server);
+    composition_destroy(&comp);
+    printf("state_server_test: ok\n");
+    return 0;
+}
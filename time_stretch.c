@@ -0,0 +1,162 @@
+/** COMP3601 Design Project A
+ * File name: time_stretch.c
+ * Description: Waveform similarity overlap-add (WSOLA). Each output frame is taken from around its
+ * 	nominal position in the input, shifted by up to TS_TOLERANCE samples so it lines up with the
+ * 	natural continuation of the previous frame. The best shift is found with an FFT cross-correlation.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fft.h"
+#include "time_stretch.h"
+
+// FFT size for the correlation, must hold the search region (TS_FRAME_LEN + 2*TS_TOLERANCE) without wrapping
+#define TS_FFT_LEN 2048
+
+static float sample_at(const int32_t *in, uint32_t in_len, int64_t pos) {
+    // Reads past either end of the recording are treated as silence
+    if (pos < 0 || pos >= (int64_t)in_len) {
+        return 0.0f;
+    }
+    return (float)in[pos];
+}
+
+static int32_t *resample_linear(const int32_t *in, uint32_t in_len, uint32_t out_len) {
+    // Fallback for sounds shorter than one frame, where WSOLA has nothing to overlap
+    int32_t *out = (int32_t *)malloc(out_len * sizeof(int32_t));
+    if (out == NULL) {
+        return NULL;
+    }
+    double step = out_len > 1 ? (double)(in_len - 1) / (out_len - 1) : 0.0;
+    for (uint32_t i = 0; i < out_len; i++) {
+        double x = i * step;
+        uint32_t a = (uint32_t)x;
+        uint32_t b = a + 1 < in_len ? a + 1 : a;
+        double frac = x - a;
+        out[i] = (int32_t)lrint(in[a] * (1.0 - frac) + in[b] * frac);
+    }
+    return out;
+}
+
+static int64_t best_offset(const fft_plan_t *plan, float *re, float *im, float *tre, float *tim,
+                           const int32_t *in, uint32_t in_len, int64_t prev_pos, int64_t nominal) {
+    // Template: where the previous frame would have continued to
+    memset(tre, 0, TS_FFT_LEN * sizeof(float));
+    memset(tim, 0, TS_FFT_LEN * sizeof(float));
+    for (int i = 0; i < TS_FRAME_LEN; i++) {
+        tre[i] = sample_at(in, in_len, prev_pos + TS_SYNTH_HOP + i);
+    }
+
+    // Search region: the nominal frame widened by the tolerance on each side
+    int64_t region_start = nominal - TS_TOLERANCE;
+    memset(re, 0, TS_FFT_LEN * sizeof(float));
+    memset(im, 0, TS_FFT_LEN * sizeof(float));
+    for (int i = 0; i < TS_FRAME_LEN + 2 * TS_TOLERANCE; i++) {
+        re[i] = sample_at(in, in_len, region_start + i);
+    }
+
+    fft_execute(plan, tre, tim, false);
+    fft_execute(plan, re, im, false);
+
+    // region * conj(template) gives the cross-correlation once transformed back
+    for (int k = 0; k < TS_FFT_LEN; k++) {
+        float r = re[k] * tre[k] + im[k] * tim[k];
+        float i = im[k] * tre[k] - re[k] * tim[k];
+        re[k] = r;
+        im[k] = i;
+    }
+    fft_execute(plan, re, im, true);
+
+    int64_t best = nominal;
+    float best_corr = -INFINITY;
+    for (int d = 0; d <= 2 * TS_TOLERANCE; d++) {
+        int64_t pos = region_start + d;
+        if (pos < 0 || pos >= (int64_t)in_len) {
+            continue;
+        }
+        if (re[d] > best_corr) {
+            best_corr = re[d];
+            best = pos;
+        }
+    }
+    return best;
+}
+
+int32_t *time_stretch_fit(const int32_t *in, uint32_t in_len, uint32_t out_len) {
+    if (in == NULL || in_len == 0 || out_len == 0) {
+        return NULL;
+    }
+
+    if (in_len == out_len) {
+        int32_t *out = (int32_t *)malloc(out_len * sizeof(int32_t));
+        if (out != NULL) {
+            memcpy(out, in, out_len * sizeof(int32_t));
+        }
+        return out;
+    }
+
+    if (in_len < TS_FRAME_LEN || out_len < TS_FRAME_LEN) {
+        return resample_linear(in, in_len, out_len);
+    }
+
+    // accumulators are a frame longer than the output so the last frame can spill over
+    uint32_t acc_len = out_len + TS_FRAME_LEN;
+    float *acc = (float *)calloc(acc_len, sizeof(float));
+    float *wsum = (float *)calloc(acc_len, sizeof(float));
+    float *window = (float *)malloc(TS_FRAME_LEN * sizeof(float));
+    float *buf = (float *)malloc(4 * TS_FFT_LEN * sizeof(float));
+    int32_t *out = (int32_t *)malloc(out_len * sizeof(int32_t));
+    fft_plan_t *plan = fft_plan_create(TS_FFT_LEN);
+    if (acc == NULL || wsum == NULL || window == NULL || buf == NULL || out == NULL || plan == NULL) {
+        free(acc);
+        free(wsum);
+        free(window);
+        free(buf);
+        free(out);
+        fft_plan_destroy(plan);
+        return NULL;
+    }
+
+    // periodic hann, sums to one at 50% overlap
+    for (int i = 0; i < TS_FRAME_LEN; i++) {
+        window[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / TS_FRAME_LEN);
+    }
+
+    double alpha = (double)in_len / out_len;  // analysis hop / synthesis hop
+    int64_t prev_pos = 0;
+    for (uint32_t k = 0; (uint64_t)k * TS_SYNTH_HOP < out_len; k++) {
+        uint32_t out_pos = k * TS_SYNTH_HOP;
+        int64_t pos = 0;
+        if (k > 0) {
+            int64_t nominal = llround(out_pos * alpha);
+            pos = best_offset(plan, buf, buf + TS_FFT_LEN, buf + 2 * TS_FFT_LEN, buf + 3 * TS_FFT_LEN,
+                              in, in_len, prev_pos, nominal);
+        }
+
+        for (int i = 0; i < TS_FRAME_LEN; i++) {
+            acc[out_pos + i] += window[i] * sample_at(in, in_len, pos + i);
+            wsum[out_pos + i] += window[i];
+        }
+        prev_pos = pos;
+    }
+
+    for (uint32_t i = 0; i < out_len; i++) {
+        float v = wsum[i] > 1e-3f ? acc[i] / wsum[i] : acc[i];
+        if (v >= 2147483647.0f) {
+            out[i] = INT32_MAX;
+        } else if (v <= -2147483648.0f) {
+            out[i] = INT32_MIN;
+        } else {
+            out[i] = (int32_t)lrintf(v);
+        }
+    }
+
+    free(acc);
+    free(wsum);
+    free(window);
+    free(buf);
+    fft_plan_destroy(plan);
+    return out;
+}
@@ -0,0 +1,19 @@
+/** COMP3601 Design Project A
+ * File name: time_stretch.h
+ * Description: WSOLA time-stretch used to fit recorded sounds to the length of one grid step.
+ */
+
+#ifndef TIME_STRETCH_H
+#define TIME_STRETCH_H
+
+#include <stdint.h>
+
+#define TS_FRAME_LEN 1024                   // analysis/synthesis frame, ~25ms at 41kHz
+#define TS_SYNTH_HOP (TS_FRAME_LEN / 2)     // 50% overlap so the hann windows sum to one
+#define TS_TOLERANCE (TS_FRAME_LEN / 4)     // how far (in samples) a frame may move to line up with the previous one
+
+// Stretch or squash in[0..in_len) so that it lasts exactly out_len samples without changing the pitch.
+// Returns a malloc'd buffer of out_len samples (caller frees), or NULL on failure.
+int32_t *time_stretch_fit(const int32_t *in, uint32_t in_len, uint32_t out_len);
+
+#endif
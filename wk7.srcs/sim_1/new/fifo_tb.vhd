@@ -0,0 +1,143 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library work;
+use work.aud_param.all;
+
+-- Checks the FIFO keeps order, reports its level, and that writes while full
+-- are dropped, flagged and counted until the next reset.
+entity fifo_tb is
+end fifo_tb;
+
+architecture behavior of fifo_tb is
+
+    constant DATA_WIDTH : positive := 32;
+    constant FIFO_DEPTH : positive := 3;                -- 8 words of RAM
+    constant CAPACITY   : integer := 2**FIFO_DEPTH + 1;   -- plus the output register
+
+   --Inputs
+   signal clk : std_logic := '0';
+   signal rst : std_logic := '1';
+   signal wr : std_logic := '0';
+   signal rd : std_logic := '0';
+   signal din : std_logic_vector(DATA_WIDTH-1 downto 0) := (others => '0');
+
+    --Outputs
+   signal empty : std_logic;
+   signal full : std_logic;
+   signal dout : std_logic_vector(DATA_WIDTH-1 downto 0);
+   signal level : std_logic_vector(FIFO_DEPTH+1 downto 0);
+   signal overflow : std_logic;
+   signal dropped : std_logic_vector(31 downto 0);
+
+   -- Clock period definitions
+   constant clk_period : time := 10 ns;  -- 100 MHz
+
+begin
+
+    -- Instantiate the Unit Under Test (UUT)
+   uut: fifo
+   generic map (
+          DATA_WIDTH => DATA_WIDTH,
+          FIFO_DEPTH => FIFO_DEPTH
+        )
+   port map (
+          clkw => clk,
+          clkr => clk,
+          rst => rst,
+          wr => wr,
+          rd => rd,
+          din => din,
+          empty => empty,
+          full => full,
+          dout => dout,
+          level => level,
+          overflow => overflow,
+          dropped => dropped
+        );
+
+   -- Clock process definitions
+   clk_process :process
+   begin
+      clk <= '0';
+      wait for clk_period/2;
+      clk <= '1';
+      wait for clk_period/2;
+   end process;
+
+   stim_proc: process
+
+      procedure tick is
+      begin
+         wait until rising_edge(clk);
+         wait for 1 ns;
+      end procedure;
+
+      procedure push(value : integer) is
+      begin
+         wr <= '1';
+         din <= std_logic_vector(to_unsigned(value, DATA_WIDTH));
+         tick;
+         wr <= '0';
+      end procedure;
+
+      procedure pop(expected : integer) is
+      begin
+         assert empty = '0' report "FIFO empty, expected " & integer'image(expected) severity error;
+         assert to_integer(unsigned(dout)) = expected
+            report "read " & integer'image(to_integer(unsigned(dout))) & ", expected " & integer'image(expected) severity error;
+         rd <= '1';
+         tick;
+         rd <= '0';
+      end procedure;
+
+   begin
+      tick;
+      rst <= '0';
+      tick;
+      assert empty = '1' and to_integer(unsigned(level)) = 0 report "not empty after reset" severity error;
+
+      -- words come out in order and the level follows
+      for i in 1 to 3 loop
+         push(i);
+      end loop;
+      tick;
+      assert to_integer(unsigned(level)) = 3 report "level should be 3" severity error;
+      for i in 1 to 3 loop
+         pop(i);
+      end loop;
+      tick;
+      assert empty = '1' and to_integer(unsigned(level)) = 0 report "not empty after reading everything" severity error;
+
+      -- fill past capacity, the extra writes are dropped and counted
+      for i in 1 to CAPACITY + 3 loop
+         push(100 + i);
+         tick;
+      end loop;
+      assert full = '1' report "not full" severity error;
+      assert overflow = '1' report "overflow not flagged" severity error;
+      assert to_integer(unsigned(dropped)) = 3
+         report "dropped " & integer'image(to_integer(unsigned(dropped))) & ", expected 3" severity error;
+      assert to_integer(unsigned(level)) = CAPACITY report "level should be at capacity" severity error;
+
+      -- the overflow flag is sticky, the kept words are the first ones written
+      for i in 1 to CAPACITY loop
+         pop(100 + i);
+      end loop;
+      tick;
+      assert empty = '1' report "not empty after draining" severity error;
+      assert overflow = '1' report "overflow flag should stay set until reset" severity error;
+
+      -- reset clears the flag and the counter
+      rst <= '1';
+      tick;
+      rst <= '0';
+      tick;
+      assert overflow = '0' and to_integer(unsigned(dropped)) = 0 report "reset did not clear overflow" severity error;
+
+      report "fifo_tb finished" severity note;
+      wait;
+   end process;
+
+end behavior;
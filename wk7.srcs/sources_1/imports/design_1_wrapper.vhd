@@ -14,6 +14,7 @@ use UNISIM.VCOMPONENTS.ALL;
 entity design_1_wrapper is
   port (
     pmod_i2s_bclk : out STD_LOGIC;
+    pmod_i2s_dac_din : out STD_LOGIC;
     pmod_i2s_dout : in STD_LOGIC;
     pmod_i2s_lrclk : out STD_LOGIC
   );
@@ -24,13 +25,15 @@ architecture STRUCTURE of design_1_wrapper is
   port (
     pmod_i2s_lrclk : out STD_LOGIC;
     pmod_i2s_bclk : out STD_LOGIC;
-    pmod_i2s_dout : in STD_LOGIC
+    pmod_i2s_dout : in STD_LOGIC;
+    pmod_i2s_dac_din : out STD_LOGIC
   );
   end component design_1;
 begin
 design_1_i: component design_1
      port map (
       pmod_i2s_bclk => pmod_i2s_bclk,
+      pmod_i2s_dac_din => pmod_i2s_dac_din,
       pmod_i2s_dout => pmod_i2s_dout,
       pmod_i2s_lrclk => pmod_i2s_lrclk
     );
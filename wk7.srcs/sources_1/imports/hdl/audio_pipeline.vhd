@@ -10,8 +10,9 @@ entity audio_pipeline is
         PCM_PRECISION : integer := 18;
         PCM_WIDTH : integer := 24;
         DATA_WIDTH : integer := 32;
-        FIFO_DEPTH : integer := 12;
+        FIFO_DEPTH : integer := 12;         -- log2 of the FIFO size, at most 14 so the level fits the status register
         TRANSFER_LEN : integer := 5;
+        DEFAULT_PACKET_LEN : integer := 256;    -- words per AXIS packet while the packet length register is 0
 		C_S00_AXI_DATA_WIDTH    : integer	:= 32;
 		C_S00_AXI_ADDR_WIDTH	: integer	:= 5
     );
@@ -26,6 +27,7 @@ entity audio_pipeline is
         i2s_bclk        : out std_logic;
         i2s_lrcl        : out std_logic;
         i2s_dout        : in  std_logic;
+        i2s_dac_din     : out std_logic;    -- playback to the DAC, on the same bit and word clocks
 
         --------------------------------------------------
         -- AXI4-Stream
@@ -34,6 +36,12 @@ entity audio_pipeline is
         axis_tvalid     : out std_logic;
         axis_tready     : in  std_logic;
         axis_tlast      : out std_logic;
+
+        -- playback, from the MM2S DMA channel
+        s_axis_tdata    : in  std_logic_vector(DATA_WIDTH-1 downto 0);
+        s_axis_tvalid   : in  std_logic;
+        s_axis_tready   : out std_logic;
+        s_axis_tlast    : in  std_logic;
         
         --------------------------------------------------
         -- Control interface (AXI4-Lite)
@@ -63,6 +71,13 @@ entity audio_pipeline is
 end audio_pipeline;
 
 architecture Behavioural of audio_pipeline is
+    --------------------------------------------------
+    -- I2S
+    --------------------------------------------------
+    signal sig_i2s_bclk             : std_logic;
+    signal sig_i2s_lrcl             : std_logic;
+    signal sig_tx_underrun          : std_logic;
+
     --------------------------------------------------
     -- FIFO
     --------------------------------------------------
@@ -73,6 +88,9 @@ architecture Behavioural of audio_pipeline is
     signal sig_fifo_empty           : std_logic;
     signal sig_fifo_data_w          : std_logic_vector(DATA_WIDTH-1 downto 0);
     signal sig_fifo_data_r          : std_logic_vector(DATA_WIDTH-1 downto 0);
+    signal sig_fifo_level           : std_logic_vector(FIFO_DEPTH+1 downto 0);
+    signal sig_fifo_overflow        : std_logic;
+    signal sig_fifo_dropped         : std_logic_vector(DATA_WIDTH-1 downto 0);
 
     --------------------------------------------------
     -- AXI4-Stream
@@ -81,6 +99,9 @@ architecture Behavioural of audio_pipeline is
     signal sig_axis_tvalid          : std_logic;
     signal sig_axis_tready          : std_logic;
     signal sig_axis_tlast           : std_logic;
+    signal sig_packet_cnt           : unsigned(DATA_WIDTH-1 downto 0);  -- words sent in the current packet
+    signal sig_packet_last          : unsigned(DATA_WIDTH-1 downto 0);  -- count of the packet's last word
+    signal sig_packet_reg_last      : unsigned(DATA_WIDTH-1 downto 0);  -- the same for the length register
 
     --------------------------------------------------
     -- Control interface (AXI4-Lite)
@@ -88,10 +109,30 @@ architecture Behavioural of audio_pipeline is
     signal sig_control_reg          : std_logic_vector(DATA_WIDTH-1 downto 0);
     signal sig_status_reg           : std_logic_vector(DATA_WIDTH-1 downto 0);
     signal sig_gain_reg             : std_logic_vector(DATA_WIDTH-1 downto 0);
+    signal sig_packet_len_reg       : std_logic_vector(DATA_WIDTH-1 downto 0);
+
+    -- Control register bits
+    constant CR_FIFO_RST            : integer := 1;     -- hold high to empty the FIFO and clear its overflow flag/counter
 
 begin
 
-    sig_status_reg <= x"0ca7cafe";
+    --------------------------------------------------
+    -- Status register
+    --   [15:0]  FIFO level (words held)
+    --   [16]    FIFO empty
+    --   [17]    FIFO full
+    --   [18]    FIFO overflowed since the last reset (sticky)
+    --   [19]    playback ran out of samples since the last reset or FIFO reset (sticky)
+    --------------------------------------------------
+    process (sig_fifo_level, sig_fifo_empty, sig_fifo_full, sig_fifo_overflow, sig_tx_underrun)
+    begin
+        sig_status_reg <= (others => '0');
+        sig_status_reg(FIFO_DEPTH+1 downto 0) <= sig_fifo_level;
+        sig_status_reg(16) <= sig_fifo_empty;
+        sig_status_reg(17) <= sig_fifo_full;
+        sig_status_reg(18) <= sig_fifo_overflow;
+        sig_status_reg(19) <= sig_tx_underrun;
+    end process;
     --------------------------------------------------
     -- Control bus
     --------------------------------------------------
@@ -104,6 +145,8 @@ begin
         cb_control_reg  => sig_control_reg,
         cb_status_reg   => sig_status_reg,
         cb_gain_reg     => sig_gain_reg,
+        cb_dropped_reg  => sig_fifo_dropped,
+        cb_packet_len_reg => sig_packet_len_reg,
 
 		S_AXI_ACLK	    => s00_axi_aclk,
 		S_AXI_ARESETN	=> s00_axi_aresetn,
@@ -128,8 +171,8 @@ begin
 		S_AXI_RREADY	=> s00_axi_rready
 	);
 
-    -- sig_fifo_rst <= not rst; -- AXIS reset is active low
-    sig_fifo_rst <= '0';
+    -- AXIS reset is active low, software can also reset the FIFO through the control register
+    sig_fifo_rst <= (not rst) or sig_control_reg(CR_FIFO_RST);
 
     --------------------------------------------------
     -- I2S Master
@@ -143,14 +186,41 @@ begin
         clk             => clk,
         clk_1           => clk_1,
 
-        i2s_lrcl        => i2s_lrcl,
+        i2s_lrcl        => sig_i2s_lrcl,
         i2s_dout        => i2s_dout,
-        i2s_bclk        => i2s_bclk,
+        i2s_bclk        => sig_i2s_bclk,
 
         fifo_din        => sig_fifo_data_w,
         fifo_w_stb      => sig_fifo_wr,
         fifo_full       => sig_fifo_full
     );
+    i2s_bclk <= sig_i2s_bclk;
+    i2s_lrcl <= sig_i2s_lrcl;
+
+    --------------------------------------------------
+    -- I2S Transmitter
+    --------------------------------------------------
+    inst_i2s_transmitter : i2s_transmitter
+    generic map (
+        DATA_WIDTH      => DATA_WIDTH,
+        PCM_PRECISION   => PCM_PRECISION
+    )
+    port map (
+        clk             => clk,
+        rst             => rst,
+        clear           => sig_control_reg(CR_FIFO_RST),
+
+        i2s_bclk        => sig_i2s_bclk,
+        i2s_lrcl        => sig_i2s_lrcl,
+        i2s_din         => i2s_dac_din,
+
+        axis_tdata      => s_axis_tdata,
+        axis_tvalid     => s_axis_tvalid,
+        axis_tready     => s_axis_tready,
+        axis_tlast      => s_axis_tlast,
+
+        underrun        => sig_tx_underrun
+    );
 
     --------------------------------------------------
     -- FIFO
@@ -170,7 +240,11 @@ begin
 
         rd              => sig_fifo_rd,
         dout            => sig_fifo_data_r,
-        empty           => sig_fifo_empty
+        empty           => sig_fifo_empty,
+
+        level           => sig_fifo_level,
+        overflow        => sig_fifo_overflow,
+        dropped         => sig_fifo_dropped
     );
 
     --------------------------------------------------
@@ -182,26 +256,36 @@ begin
     axis_tvalid <= sig_axis_tvalid;
     
     -- TLAST
+    -- The packet length comes from the packet length register (0 = DEFAULT_PACKET_LEN). Until a
+    -- packet's first word goes out its length follows the register, so a length written between
+    -- packets (or after a reset) applies to the very next one. It is held from the first word on,
+    -- so changing it never cuts a packet short. A FIFO reset starts a new stream, the next word
+    -- begins a packet.
+    sig_packet_reg_last <= to_unsigned(DEFAULT_PACKET_LEN - 1, DATA_WIDTH) when unsigned(sig_packet_len_reg) = 0
+                           else unsigned(sig_packet_len_reg) - 1;
+
     process (clk)
-        -- variable v_cnt : unsigned(3 downto 0) := (others => '0');
-        variable v_cnt : integer := 0;
     begin
         if (rst = '0') then
-            v_cnt := 0;
+            sig_packet_cnt <= (others => '0');
+            sig_packet_last <= to_unsigned(DEFAULT_PACKET_LEN - 1, DATA_WIDTH);
         elsif rising_edge(clk) then
-            if ((sig_axis_tvalid and axis_tready) = '1') then
-                v_cnt := v_cnt + 1;
-                
-                if (v_cnt = 256) then
-                    axis_tlast <= '1';
-                    v_cnt := 0;
+            if (sig_control_reg(CR_FIFO_RST) = '1') then
+                sig_packet_cnt <= (others => '0');
+                sig_packet_last <= sig_packet_reg_last;
+            elsif ((sig_axis_tvalid and axis_tready) = '1') then
+                if (sig_packet_cnt = sig_packet_last) then
+                    sig_packet_cnt <= (others => '0');
+                    sig_packet_last <= sig_packet_reg_last;
                 else
-                    axis_tlast <= '0';
+                    sig_packet_cnt <= sig_packet_cnt + 1;
                 end if;
+            elsif (sig_packet_cnt = 0) then
+                sig_packet_last <= sig_packet_reg_last;
             end if;
         end if;
     end process;
-    -- axis_tlast <= '1';
+    axis_tlast <= '1' when sig_packet_cnt = sig_packet_last else '0';
 
     -- TDATA
     -- axis_tdata <= sig_fifo_data_r when (sig_axis_tvalid and axis_tready) = '1' else (others => '0');
@@ -23,6 +23,8 @@ entity ctrl_bus is
         cb_control_reg      : out std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0);
         cb_status_reg       : in  std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0);
         cb_gain_reg         : out std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0);
+        cb_dropped_reg      : in  std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0);
+        cb_packet_len_reg   : out std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0);
 
         ------------------------------------------------
         -- AXI Lite signals
@@ -123,8 +125,8 @@ architecture arch_imp of ctrl_bus is
 	signal slv_reg1	:std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0); -- Status register
 	signal slv_reg2	:std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0); -- Key
 	signal slv_reg3	:std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0); -- Gain
-	signal slv_reg4	:std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0); -- Preserved 0
-	signal slv_reg5	:std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0); -- Preserved 1
+	signal slv_reg4	:std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0); -- AXIS packet length (words)
+	signal slv_reg5	:std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0); -- FIFO dropped sample count
 	signal slv_reg6	:std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0); -- Preserved 2
 	signal slv_reg7	:std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0); -- Preserved 3
     --
@@ -150,6 +152,8 @@ begin
     cb_control_reg  <= slv_reg0;
     slv_reg1        <= cb_status_reg;
     cb_gain_reg     <= slv_reg3;
+    cb_packet_len_reg <= slv_reg4;
+    slv_reg5        <= cb_dropped_reg;
 
 	-- Implement axi_awready generation
 	-- axi_awready is asserted for one S_AXI_ACLK clock cycle when both
@@ -240,8 +244,8 @@ begin
                 -- slv_reg1 <= x"00000000";     -- Status Register
                 -- slv_reg2 <= x"0CA7CAFE";        -- Key
                 slv_reg3 <= (others => '0');    -- Gain
-                slv_reg4 <= (others => '0');    -- Preserved 0
-                slv_reg5 <= (others => '0');    -- Preserved 1
+                slv_reg4 <= (others => '0');    -- AXIS packet length
+                -- slv_reg5 <= (others => '0');  -- FIFO dropped sample count
                 slv_reg6 <= (others => '0');    -- Preserved 2
                 slv_reg7 <= (others => '0');    -- Preserved 3
             else
@@ -285,7 +289,7 @@ begin
                             end if;
                         end loop;
                     when b"100" =>
-                        ---- Preserved 0 register
+                        ---- AXIS packet length register
                         for byte_index in 0 to (C_S_AXI_DATA_WIDTH/8-1) loop
                             if ( S_AXI_WSTRB(byte_index) = '1' ) then
                                 -- Respective byte enables are asserted as per write strobes                   
@@ -294,14 +298,14 @@ begin
                             end if;
                         end loop;
                     when b"101" =>
-                        ---- Preserved 1 register
-                        for byte_index in 0 to (C_S_AXI_DATA_WIDTH/8-1) loop
-                            if ( S_AXI_WSTRB(byte_index) = '1' ) then
-                                -- Respective byte enables are asserted as per write strobes                   
-                                -- slave registor 5
-                                slv_reg5(byte_index*8+7 downto byte_index*8) <= S_AXI_WDATA(byte_index*8+7 downto byte_index*8);
-                            end if;
-                        end loop;
+                        ---- FIFO dropped sample count register (read only)
+                        -- for byte_index in 0 to (C_S_AXI_DATA_WIDTH/8-1) loop
+                        --     if ( S_AXI_WSTRB(byte_index) = '1' ) then
+                        --         -- Respective byte enables are asserted as per write strobes                   
+                        --         -- slave registor 5
+                        --         slv_reg5(byte_index*8+7 downto byte_index*8) <= S_AXI_WDATA(byte_index*8+7 downto byte_index*8);
+                        --     end if;
+                        -- end loop;
                     when b"110" =>
                         ---- Preserved 2 register
                         for byte_index in 0 to (C_S_AXI_DATA_WIDTH/8-1) loop
@@ -429,9 +433,9 @@ begin
             when b"011" =>
                 reg_data_out <= slv_reg3;   -- Gain Register
             when b"100" =>
-                reg_data_out <= slv_reg4;   -- Preserved Register 0
+                reg_data_out <= slv_reg4;   -- Packet Length Register
             when b"101" =>
-                reg_data_out <= slv_reg5;   -- Preserved Register 1
+                reg_data_out <= slv_reg5;   -- FIFO Dropped Register
             when b"110" =>
                 reg_data_out <= slv_reg6;   -- Preserved Register 2
             when b"111" =>
@@ -2,21 +2,30 @@ library ieee;
 use ieee.std_logic_1164.all;
 use ieee.numeric_std.all;
 
+-- First word fall through FIFO of 2**FIFO_DEPTH words, backed by block RAM.
+-- The RAM is read synchronously into an output register, which keeps dout valid
+-- while empty = '0' and is refilled on the cycle after a read.
+-- Writes while full are dropped: they set the sticky overflow flag and are counted
+-- in dropped (saturating). level is the number of words held, output register included.
+-- clkw and clkr must be the same clock (the pointers are compared without synchronisers).
 entity fifo is
     generic (
         DATA_WIDTH : positive := 32;
         FIFO_DEPTH : positive := 5
     );
     port (
-        clkw    : in  std_logic;
-        clkr    : in  std_logic;
-        rst     : in  std_logic;
-        wr      : in  std_logic;
-        rd      : in  std_logic;
-        din     : in  std_logic_vector(DATA_WIDTH-1 downto 0);
-        empty   : out std_logic;
-        full    : out std_logic;
-        dout    : out std_logic_vector(DATA_WIDTH-1 downto 0)
+        clkw     : in  std_logic;
+        clkr     : in  std_logic;
+        rst      : in  std_logic;
+        wr       : in  std_logic;
+        rd       : in  std_logic;
+        din      : in  std_logic_vector(DATA_WIDTH-1 downto 0);
+        empty    : out std_logic;
+        full     : out std_logic;
+        dout     : out std_logic_vector(DATA_WIDTH-1 downto 0);
+        level    : out std_logic_vector(FIFO_DEPTH+1 downto 0);
+        overflow : out std_logic;
+        dropped  : out std_logic_vector(31 downto 0)
     );
 end fifo;
 
@@ -24,19 +33,46 @@ architecture arch of fifo is
 
     type fifo_t is array (0 to 2**FIFO_DEPTH-1) of std_logic_vector(DATA_WIDTH-1 downto 0);
     signal mem : fifo_t;
+    attribute ram_style : string;
+    attribute ram_style of mem : signal is "block";
 
+    -- one extra bit on each pointer tells full apart from empty
     signal rdp, wrp : unsigned(FIFO_DEPTH downto 0) := (others => '0');
-    signal int_rdp : unsigned(FIFO_DEPTH-1 downto 0);
-    signal int_wrp : unsigned(FIFO_DEPTH-1 downto 0);
 
+    signal sig_ram_count : unsigned(FIFO_DEPTH downto 0);
+    signal sig_ram_empty : std_logic;
     signal sig_full : std_logic;
-    signal sig_empty : std_logic;
+    signal sig_write : std_logic;
+    signal sig_fetch : std_logic;
+
+    signal sig_dout : std_logic_vector(DATA_WIDTH-1 downto 0) := (others => '0');
+    signal sig_dout_valid : std_logic := '0';
+
+    signal sig_overflow : std_logic := '0';
+    signal sig_dropped : unsigned(31 downto 0) := (others => '0');
 begin
 
+    sig_ram_count <= wrp - rdp;
+    sig_ram_empty <= '1' when rdp = wrp else '0';
+    sig_full <= '1' when sig_ram_count(FIFO_DEPTH) = '1' else '0';
+    sig_write <= wr and not sig_full;
+
+    -- move the next word into the output register when it is empty or being read
+    sig_fetch <= (not sig_ram_empty) and ((not sig_dout_valid) or rd);
+
+    full <= sig_full;
+    empty <= not sig_dout_valid;
+    dout <= sig_dout;
+    level <= std_logic_vector(resize(sig_ram_count, FIFO_DEPTH+2) + 1) when sig_dout_valid = '1' else
+             std_logic_vector(resize(sig_ram_count, FIFO_DEPTH+2));
+    overflow <= sig_overflow;
+    dropped <= std_logic_vector(sig_dropped);
+
+    -- RAM write port
     process(clkw) begin
         if rising_edge(clkw) then
-            if wr = '1' then
-                mem(to_integer(wrp(FIFO_DEPTH - 1 downto 0))) <= din;
+            if sig_write = '1' then
+                mem(to_integer(wrp(FIFO_DEPTH-1 downto 0))) <= din;
             end if;
         end if;
     end process;
@@ -45,40 +81,42 @@ begin
         if rising_edge(clkw) then
             if rst = '1' then
                 wrp <= (others => '0');
+                sig_overflow <= '0';
+                sig_dropped <= (others => '0');
             else
-                if wr = '1' then
+                if sig_write = '1' then
                     wrp <= wrp + 1;
                 end if;
+                if wr = '1' and sig_full = '1' then
+                    sig_overflow <= '1';
+                    if sig_dropped /= x"FFFFFFFF" then
+                        sig_dropped <= sig_dropped + 1;
+                    end if;
+                end if;
             end if;
         end if;
     end process;
 
-    full <= sig_full;
-    empty <= sig_empty;
-    sig_full <= (rdp(FIFO_DEPTH) xor wrp(FIFO_DEPTH)) when (rdp(FIFO_DEPTH-1 downto 0) = wrp(FIFO_DEPTH-1 downto 0)) else '0';
-    sig_empty <= '1' when int_rdp = wrp(FIFO_DEPTH-1 downto 0) else '0';
-    int_rdp <= rdp(FIFO_DEPTH-1 downto 0) + 1;
-    int_wrp <= wrp(FIFO_DEPTH-1 downto 0);
-    dout <= mem(to_integer(int_rdp));
-
-    -- dout <= mem(to_integer(rdp(FIFO_DEPTH-1 downto 0)));
-    -- process(clkr) begin
-    --     if rising_edge(clkr) then
-    --         if rst = '1' then
-    --             dout <= (others => '0');
-    --         elsif rd = '1' then
-    --             dout <= mem(to_integer(rdp(FIFO_DEPTH-1 downto 0)));
-    --         end if;
-    --     end if;
-    -- end process;
+    -- RAM read port, registered so it maps onto the block RAM output register
+    process(clkr) begin
+        if rising_edge(clkr) then
+            if sig_fetch = '1' then
+                sig_dout <= mem(to_integer(rdp(FIFO_DEPTH-1 downto 0)));
+            end if;
+        end if;
+    end process;
 
-    process(clkr) begin 
+    process(clkr) begin
         if rising_edge(clkr) then
             if rst = '1' then
                 rdp <= (others => '0');
+                sig_dout_valid <= '0';
             else
-                if (rd = '1' and sig_empty = '0') or sig_full = '1' then
+                if sig_fetch = '1' then
                     rdp <= rdp + 1;
+                    sig_dout_valid <= '1';
+                elsif rd = '1' then
+                    sig_dout_valid <= '0';
                 end if;
             end if;
         end if;
@@ -170,7 +170,8 @@ begin
     process(clk) -- may need to change this so that the strobe is set off quicker?
     begin
         if rising_edge(clk) then
-            if fifo_full = '0' and fifo_done = '0'and ready = '1' and fsm_counter = 19 and i2s_bclk_counter = 1 then          
+            -- the strobe is not held back when the FIFO is full, the FIFO drops the sample and counts it
+            if fifo_done = '0'and ready = '1' and fsm_counter = 19 and i2s_bclk_counter = 1 then          
                 fifo_w_stb <= '1';
                 fifo_done <= '1';         
             else
@@ -0,0 +1,98 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+-- I2S transmitter stub for the playback path: takes samples from the MM2S AXI4-Stream and
+-- shifts them out to a DAC on the bit and word clocks generated by i2s_master.
+-- One stream word is one mono sample and is sent on both channels. Samples use the software's
+-- format in both directions: signed, full scale in DATA_WIDTH bits, of which the top PCM_PRECISION
+-- bits are sent (capture delivers the microphone's PCM_PRECISION bits in the same place once the
+-- driver has reversed them). A word is taken at the start of every left
+-- channel slot. If the stream has none, silence is sent and underrun is set until reset or clear.
+-- Data changes on the falling edge of bclk, MSB first, one bit after the word clock changes.
+-- tlast only marks the end of a DMA transfer and is ignored.
+entity i2s_transmitter is
+    generic (
+        DATA_WIDTH : natural := 32;
+        PCM_PRECISION : natural := 18
+    );
+    port (
+        clk             : in  std_logic;
+        rst             : in  std_logic;    -- active low, like the AXIS reset
+        clear           : in  std_logic;    -- clears underrun, the software FIFO reset
+
+        -- I2S clocks from i2s_master and serial data to the DAC
+        i2s_bclk        : in  std_logic;
+        i2s_lrcl        : in  std_logic;    -- 0 = left, 1 = right
+        i2s_din         : out std_logic;    -- serial data: payload, msb first
+
+        -- AXI4-Stream from the MM2S DMA channel
+        axis_tdata      : in  std_logic_vector(DATA_WIDTH-1 downto 0);
+        axis_tvalid     : in  std_logic;
+        axis_tready     : out std_logic;
+        axis_tlast      : in  std_logic;
+
+        underrun        : out std_logic     -- sticky, a sample was due and the stream had none
+    );
+end i2s_transmitter;
+
+architecture Behavioral of i2s_transmitter is
+    signal sig_bclk_d       : std_logic := '0';
+    signal sig_lrcl_d       : std_logic := '0';     -- word clock at the previous falling edge of bclk
+    signal sig_sample       : std_logic_vector(PCM_PRECISION-1 downto 0) := (others => '0');
+    signal sig_shift        : std_logic_vector(PCM_PRECISION-1 downto 0) := (others => '0');
+    signal sig_dout         : std_logic := '0';
+    signal sig_tready       : std_logic := '0';
+    signal sig_underrun     : std_logic := '0';
+
+begin
+
+    process (clk)
+    begin
+        if rising_edge(clk) then
+            -- tready is high for one cycle, the word sampled below is held until then
+            sig_tready <= '0';
+            if rst = '0' then
+                sig_bclk_d <= '0';
+                sig_lrcl_d <= '0';
+                sig_sample <= (others => '0');
+                sig_shift <= (others => '0');
+                sig_dout <= '0';
+                sig_underrun <= '0';
+            else
+                if clear = '1' then
+                    sig_underrun <= '0';
+                end if;
+                sig_bclk_d <= i2s_bclk;
+                if sig_bclk_d = '1' and i2s_bclk = '0' then
+                    sig_lrcl_d <= i2s_lrcl;
+                    if i2s_lrcl /= sig_lrcl_d then
+                        -- new slot: one delay bit, then the sample
+                        if i2s_lrcl = '0' then
+                            if axis_tvalid = '1' and sig_tready = '0' then
+                                sig_sample <= axis_tdata(DATA_WIDTH-1 downto DATA_WIDTH-PCM_PRECISION);
+                                sig_shift <= axis_tdata(DATA_WIDTH-1 downto DATA_WIDTH-PCM_PRECISION);
+                                sig_tready <= '1';
+                            else
+                                sig_sample <= (others => '0');
+                                sig_shift <= (others => '0');
+                                sig_underrun <= '1';
+                            end if;
+                        else
+                            sig_shift <= sig_sample;
+                        end if;
+                        sig_dout <= '0';
+                    else
+                        sig_dout <= sig_shift(PCM_PRECISION-1);
+                        sig_shift <= sig_shift(PCM_PRECISION-2 downto 0) & '0';
+                    end if;
+                end if;
+            end if;
+        end if;
+    end process;
+
+    i2s_din <= sig_dout;
+    axis_tready <= sig_tready;
+    underrun <= sig_underrun;
+
+end Behavioral;
@@ -26,6 +26,31 @@ package aud_param is
         );
     end component;
 
+    component i2s_transmitter is
+        generic (
+            DATA_WIDTH : natural := 32;
+            PCM_PRECISION : natural := 18
+        );
+        port (
+            clk             : in  std_logic;
+            rst             : in  std_logic;
+            clear           : in  std_logic;
+
+            -- I2S clocks from i2s_master and serial data to the DAC
+            i2s_bclk        : in  std_logic;
+            i2s_lrcl        : in  std_logic;
+            i2s_din         : out std_logic;
+
+            -- AXI4-Stream from the MM2S DMA channel
+            axis_tdata      : in  std_logic_vector(DATA_WIDTH-1 downto 0);
+            axis_tvalid     : in  std_logic;
+            axis_tready     : out std_logic;
+            axis_tlast      : in  std_logic;
+
+            underrun        : out std_logic
+        );
+    end component;
+
     component fifo is
         generic (
             DATA_WIDTH : positive := 32;
@@ -40,7 +65,10 @@ package aud_param is
             din     : in  std_logic_vector(DATA_WIDTH-1 downto 0);
             empty   : out std_logic;
             full    : out std_logic;
-            dout    : out std_logic_vector(DATA_WIDTH-1 downto 0)
+            dout    : out std_logic_vector(DATA_WIDTH-1 downto 0);
+            level   : out std_logic_vector(FIFO_DEPTH+1 downto 0);     -- words held
+            overflow: out std_logic;                                   -- sticky, a write was dropped
+            dropped : out std_logic_vector(31 downto 0)                -- number of dropped writes
         );
     end component;
    
@@ -49,7 +77,7 @@ package aud_param is
             PCM_PRECISION : integer := 18;
             PCM_WIDTH : integer := 24;
             DATA_WIDTH : integer := 32;
-            FIFO_DEPTH : integer := 5;
+            FIFO_DEPTH : integer := 12;         -- log2 of the FIFO size
             TRANSFER_LEN : integer := 5
         );
         port(
@@ -95,6 +123,8 @@ package aud_param is
             cb_control_reg      : out std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0);
             cb_status_reg       : in  std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0);
             cb_gain_reg         : out std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0);
+            cb_dropped_reg      : in  std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0);
+            cb_packet_len_reg   : out std_logic_vector(C_S_AXI_DATA_WIDTH-1 downto 0);
     
             ------------------------------------------------
             -- AXI Lite signals